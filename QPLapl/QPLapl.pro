@@ -9,14 +9,20 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Per-kernel call counts and times of the numerical core, reported after every calculation.
+#DEFINES += QPLAPL_PROFILE
+
 QT += widgets \
       datavisualization
 
 SOURCES += \
     abstractlineinput.cpp \
+    adaptivegrid.cpp \
     chbessel.cpp \
+    deconvolution.cpp \
     gridplot.cpp \
     gwell.cpp \
+    historymatch.cpp \
     interp_1d.cpp \
     linlogaxis.cpp \
     main.cpp \
@@ -25,17 +31,23 @@ SOURCES += \
     noteditabledelegate.cpp \
     pqgraphwindow.cpp \
     pqtview.cpp \
+    profiler.cpp \
     qgaus.cpp \
     surfacegraph.cpp \
+    treecode.cpp \
+    typecurves.cpp \
     wellcontroller.cpp \
     picmanager.cpp
 
 HEADERS += \
     abstractlineinput.h \
+    adaptivegrid.h \
     auxillary.h \
     chbessel.h \
+    deconvolution.h \
     gridplot.h \
     gwell.h \
+    historymatch.h \
     interfacemaps.h \
     interp_1d.h \
     linlogaxis.h \
@@ -44,9 +56,12 @@ HEADERS += \
     noteditabledelegate.h \
     pqgraphwindow.h \
     pqtview.h \
+    profiler.h \
     qgaus.h \
     quadrature.h \
     surfacegraph.h \
+    treecode.h \
+    typecurves.h \
     wellcontroller.h \
     picmanager.h
 
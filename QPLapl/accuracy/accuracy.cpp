@@ -0,0 +1,487 @@
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <quadmath.h>
+#include "gwell.h"
+#include "typecurves.h"
+
+using namespace std;
+
+// Relative errors of FastBessel::Bess against quadruple precision references computed here,
+// of LaplWell::pwd and pwd_full against the reference curves of a fixture file,
+// of the symmetric grids of LaplWell::pd_m_parallel against the full ones,
+// and of the TypeCurveLibrary lookups against the exact solver.
+// The curves are Gaver-Wynn-Rho inversions of pwd_lapl, which are a few orders more accurate than
+// the Stehfest one with NCOEF terms, or exact solutions where they exist.
+// The exit code is 1 if any error is above its tolerance, so the report can gate optimization work.
+
+typedef __float128 Q;
+
+static const Q EUL_GAMMA_Q = 0.5772156649015328606065120900824024q;
+static const double BESS_TOL = 1e-12;
+static const int GWR_M = 12; // Gaver functionals of the reference inversion, needs 2*GWR_M transforms
+static const int GL_POINTS = 20;
+static const int DEC_MIN = -4, DEC_MAX = 2; // decades of x for Bess
+static const int POINTS_PER_DECADE = 50;
+static const int TD_DEC_MIN = -3, TD_DEC_MAX = 5; // decades of td for pwd
+static const int TD_PER_DECADE = 4;
+// the series of the images are cut at SUM_EPS where their terms are, which is not symmetric in x,
+// Stehfest amplifies that to ~1e-7 of the largest pd at td = 100
+static const double SYM_TOL = 1e-6;
+static const int SYM_DEC_MIN = -2, SYM_DEC_MAX = 2; // decades of td for pd_m_parallel, one td each
+static const int TC_THREADS = 4;
+static const double TC_CHECK_ERR = 0.1; // max_err of the lookups on the coarse lattice of the check
+static const double TC_EXACT_TOL = 1e-12; // of the fallback against the exact solver, the same calculation
+
+//---quadruple precision references---------
+
+static Q IQ(const int nu, const Q x) {
+    // power series of BesselI[nu,x], nu = 0, 1
+    Q y = 0.25q*x*x;
+    Q term = nu == 0 ? 1.q : 0.5q*x;
+    Q sum = term;
+    for (int k = 1; term > 1e-36q*sum; ++k) {
+        term *= y/(k*(k + nu));
+        sum += term;
+    }
+    return sum;
+}
+
+static Q KAsympt(const int nu, const Q x) {
+    // asymptotic series of BesselK[nu,x], stopped at its smallest term
+    Q term = 1.q, sum = 1.q;
+    for (int k = 1; k < 200; ++k) {
+        Q next = term*(4*nu*nu - (2*k - 1)*(2*k - 1))/(8.q*k*x);
+        if (fabsq(next) >= fabsq(term) || fabsq(next) < 1e-36q) break;
+        term = next;
+        sum += term;
+    }
+    return sqrtq(M_PIq/(2.q*x))*expq(-x)*sum;
+}
+
+static Q K0Q(const Q x) {
+    if (x > 20.q) return KAsympt(0, x);
+    Q y = 0.25q*x*x;
+    Q term = 1.q, h = 0.q, sum = 0.q;
+    for (int k = 1; k < 200; ++k) {
+        term *= y/(k*k);
+        h += 1.q/k;
+        sum += term*h;
+        if (term*h < 1e-36q*sum) break;
+    }
+    return -(logq(0.5q*x) + EUL_GAMMA_Q)*IQ(0, x) + sum;
+}
+
+static Q K1Q(const Q x) {
+    if (x > 20.q) return KAsympt(1, x);
+    // A&S 9.6.11, psi(k+1) + psi(k+2) = 2*H_k + 1/(k+1) - 2*gamma
+    Q y = 0.25q*x*x;
+    Q term = 1.q, h = 0.q;
+    Q sum = 1.q - 2.q*EUL_GAMMA_Q;
+    for (int k = 1; k < 200; ++k) {
+        term *= y/(k*(k + 1));
+        h += 1.q/k;
+        Q t = term*(2.q*h + 1.q/(k + 1) - 2.q*EUL_GAMMA_Q);
+        sum += t;
+        if (fabsq(t) < 1e-36q*fabsq(sum)) break;
+    }
+    return 1.q/x + logq(0.5q*x)*IQ(1, x) - 0.25q*x*sum;
+}
+
+static const vector<pair<Q, Q>>& GaussLegendre() {
+    // abscissas and weights on [-1, 1] by Newton iterations on the Legendre polynomial
+    static const vector<pair<Q, Q>> gl = [] {
+        vector<pair<Q, Q>> v;
+        for (int i = 1; i <= GL_POINTS; ++i) {
+            Q z = cosq(M_PIq*(i - 0.25q)/(GL_POINTS + 0.5q)), pp = 0.q;
+            for (int it = 0; it < 100; ++it) {
+                Q p1 = 1.q, p2 = 0.q;
+                for (int j = 1; j <= GL_POINTS; ++j) {
+                    Q p3 = p2;
+                    p2 = p1;
+                    p1 = ((2*j - 1)*z*p2 - (j - 1)*p3)/j;
+                }
+                pp = GL_POINTS*(z*p1 - p2)/(z*z - 1.q);
+                Q dz = p1/pp;
+                z -= dz;
+                if (fabsq(dz) < 1e-34q) break;
+            }
+            v.push_back({z, 2.q/((1.q - z*z)*pp*pp)});
+        }
+        return v;
+    }();
+    return gl;
+}
+
+static Q IntK0Q(const Q a, const Q b) {
+    // composite Gauss-Legendre integral of BesselK[0,t] over [a,b], a > 0 away from the log singularity
+    int n = static_cast<int>(ceilq(2.q*(b - a)));
+    Q h = (b - a)/n, sum = 0.q;
+    for (int k = 0; k < n; ++k) {
+        Q xm = a + (k + 0.5q)*h;
+        for (auto& p: GaussLegendre())
+            sum += p.second*K0Q(xm + 0.5q*h*p.first);
+    }
+    return 0.5q*h*sum;
+}
+
+static Q IK00xQ(const Q x) {
+    // series of BesselK[0,t] integrated over [0,x]; pi/2 minus the tail where it cancels
+    if (x > 30.q) return M_PI_2q - IntK0Q(x, x + 50.q);
+    Q y = 0.25q*x*x;
+    Q term = x, h = 0.q;
+    Q lg = logq(0.5q*x) + EUL_GAMMA_Q;
+    Q sum = term*(1.q - lg);
+    for (int k = 1; k < 400; ++k) {
+        term *= y/(k*k);
+        h += 1.q/k;
+        Q t = term/(2*k + 1)*(h - lg + 1.q/(2*k + 1));
+        sum += t;
+        if (fabsq(t) < 1e-36q*fabsq(sum)) break;
+    }
+    return sum;
+}
+
+static Q IK0abQ(const Q a, const Q b) {
+    return a <= 2.q ? IK00xQ(b) - IK00xQ(a) : IntK0Q(a, b);
+}
+
+//---FastBessel::Bess---------
+
+static double RelErr(const double val, const double ref) {
+    return ref == 0. ? abs(val) : abs(val/ref - 1.);
+}
+
+static void PrintHeader(const string& title, const int dmin, const int dmax) {
+    cout << "\n" << title << "\n" << setw(22) << left << "" << right;
+    for (int dec = dmin; dec <= dmax; ++dec)
+        cout << setw(10) << ("1e" + to_string(dec));
+    cout << setw(10) << "max" << "\n";
+}
+
+static double PrintRow(const string& name, const map<int, double>& errs, const int dmin, const int dmax) {
+    double emax = 0.;
+    cout << setw(22) << left << name << right << scientific << setprecision(1);
+    for (int dec = dmin; dec <= dmax; ++dec) {
+        auto it = errs.find(dec);
+        if (it == errs.end()) {
+            cout << setw(10) << "-";
+        } else {
+            cout << setw(10) << it->second;
+            emax = max(emax, it->second);
+        }
+    }
+    cout << setw(10) << emax << "\n" << defaultfloat;
+    return emax;
+}
+
+static bool CheckBess() {
+    const FastBessel::Bess& bess = FastBessel::Bess::Shared();
+    typedef function<double(double)> Func;
+    typedef function<Q(Q)> Ref;
+    const vector<tuple<string, Func, Ref>> funcs = {
+        {"k0", [&](double x) { return bess.k0(x); }, K0Q},
+        {"k1", [&](double x) { return bess.k1(x); }, K1Q},
+        {"i0", [&](double x) { return bess.i0(x); }, [](Q x) { return IQ(0, x); }},
+        {"i1", [&](double x) { return bess.i1(x); }, [](Q x) { return IQ(1, x); }},
+        {"i0e", [&](double x) { return bess.i0e(x); }, [](Q x) { return expq(-x)*IQ(0, x); }},
+        {"i1e", [&](double x) { return bess.i1e(x); }, [](Q x) { return expq(-x)*IQ(1, x); }},
+        {"k0e", [&](double x) { return bess.k0e(x); }, [](Q x) { return expq(x)*K0Q(x); }},
+        {"k1e", [&](double x) { return bess.k1e(x); }, [](Q x) { return expq(x)*K1Q(x); }},
+        {"ik00x", [&](double x) { return bess.ik00x(x); }, IK00xQ},
+        {"ik0ab(x, 1.5x)", [&](double x) { return bess.ik0ab(x, 1.5*x); }, [](Q x) { return IK0abQ(x, 1.5q*x); }},
+        {"ik0ab(x, x+0.025)", [&](double x) { return bess.ik0ab(x, x + 0.025); }, [](Q x) { return IK0abQ(x, x + 0.025q); }}
+    };
+    PrintHeader("Bess: max relative error by decade of x", DEC_MIN, DEC_MAX - 1);
+    double emax = 0.;
+    for (auto& f: funcs) {
+        map<int, double> errs;
+        for (int dec = DEC_MIN; dec < DEC_MAX; ++dec) {
+            for (int j = 0; j < POINTS_PER_DECADE; ++j) {
+                double x = pow(10., dec + static_cast<double>(j)/POINTS_PER_DECADE);
+                double ref = static_cast<double>(get<2>(f)(static_cast<Q>(x)));
+                errs[dec] = max(errs[dec], RelErr(get<1>(f)(x), ref));
+            }
+        }
+        emax = max(emax, PrintRow(get<0>(f), errs, DEC_MIN, DEC_MAX - 1));
+    }
+    return emax <= BESS_TOL;
+}
+
+//---LaplWell::pwd---------
+
+struct Case {
+    string name;
+    function<unique_ptr<LaplWell>()> make;
+    function<double(double)> exact; // empty if there is no closed form
+    double td_min; // a line source of rwd = 1 has pwd ~ exp(-0.25/td), no use in relative errors below it
+    // max relative errors of pwd and pwd_full from td = 1 on and below it, just above those of Stehfest
+    // with NCOEF = 10 and of the asymptotes; the early line source needs more terms than NCOEF
+    double tol, tol_early;
+};
+
+static const vector<Case>& Cases() {
+    static const vector<Case> cases = {
+        {"frac_nnnn_fcd1", [] { return unique_ptr<LaplWell>(new Rectangular::Fracture(Boundary::NNNN, 50., 100., 50., 100., 1.)); }, nullptr, 0., 1e-4, 1e-4},
+        {"frac_nnnn_fcd10", [] { return unique_ptr<LaplWell>(new Rectangular::Fracture(Boundary::NNNN, 50., 100., 50., 100., 10.)); }, nullptr, 0., 1e-4, 1e-4},
+        {"frac_nnnn_fcd1000", [] { return unique_ptr<LaplWell>(new Rectangular::Fracture(Boundary::NNNN, 50., 100., 50., 100., 1000.)); }, nullptr, 0., 1e-4, 1e-4},
+        {"frac_cccc_fcd10", [] { return unique_ptr<LaplWell>(new Rectangular::Fracture(Boundary::CCCC, 5., 10., 5., 10., 10.)); }, nullptr, 0., 4e-4, 4e-4},
+        {"frac_infinite_fcd10", [] { return unique_ptr<LaplWell>(new Infinite::Fracture(10.)); }, nullptr, 0., 1.5e-4, 1.5e-4},
+        {"vert_circle_nnnn", [] { return unique_ptr<LaplWell>(new Circular::Vertical(Boundary::NNNN, 1000.)); }, nullptr, 0.1, 1e-4, 3e-3},
+        {"vert_line_source", [] { return unique_ptr<LaplWell>(new Rectangular::Vertical(Boundary::NNNN, 5e3, 1e4, 5e3, 1e4)); },
+            [](double td) { return -0.5*expint(-0.25/td); }, 0.1, 1e-4, 3e-3} // the boundaries are felt after td ~ 1e6
+    };
+    return cases;
+}
+
+static double GaverWynnRho(const LaplWell& well, const double td, const int m) {
+    // Gaver functionals G_n = n*tau*C(2n,n)*sum_i (-1)^i*C(n,i)*F((n+i)*tau), tau = ln(2)/td,
+    // accelerated by the rho algorithm of Wynn, the last even column is the answer
+    const long double tau = log(2.L)/td;
+    vector<long double> f(2*m + 1);
+    for (int i = 1; i <= 2*m; ++i)
+        f[i] = well.pwd_lapl(static_cast<double>(i*tau));
+    vector<long double> rm(m + 1, 0.L), r0(m);
+    for (int n = 1; n <= m; ++n) {
+        long double c = 1.L, s = 0.L, binom = 1.L;
+        for (int i = 0; i <= n; ++i) {
+            s += c*f[n + i];
+            c *= -static_cast<long double>(n - i)/(i + 1);
+        }
+        for (int i = 1; i <= n; ++i)
+            binom *= static_cast<long double>(n + i)/i;
+        r0[n - 1] = n*tau*binom*s;
+    }
+    long double ans = r0[m - 1];
+    for (int k = 1; k < m; ++k) {
+        vector<long double> r1(m - k);
+        for (int i = 0; i < m - k; ++i) {
+            long double d = r0[i + 1] - r0[i];
+            r1[i] = d != 0.L ? rm[i + 1] + k/d : r0[i + 1];
+        }
+        rm = r0;
+        r0 = r1;
+        if (k%2 == 0) ans = r0.back();
+    }
+    return static_cast<double>(ans);
+}
+
+static vector<double> TdGrid() {
+    vector<double> tds;
+    for (int j = TD_DEC_MIN*TD_PER_DECADE; j <= TD_DEC_MAX*TD_PER_DECADE; ++j)
+        tds.push_back(pow(10., static_cast<double>(j)/TD_PER_DECADE));
+    return tds;
+}
+
+static void Generate(const string& fname) {
+    ofstream file(fname);
+    if (!file) throw runtime_error("Can not open " + fname + "\n");
+    ostream& ofs = file; // Matrix3DV converts from a file name, so no ofstream overloads
+    ofs << "# case td pwd: Gaver-Wynn-Rho inversion of pwd_lapl with " << GWR_M << " functionals or exact solution\n";
+    ofs << setprecision(17);
+    for (auto& c: Cases()) {
+        unique_ptr<LaplWell> well = c.make();
+        for (double td: TdGrid()) {
+            if (td < c.td_min) continue;
+            ofs << c.name << " " << td << " " << (c.exact ? c.exact(td) : GaverWynnRho(*well, td, GWR_M)) << "\n";
+        }
+        cout << c.name << " done" << endl;
+    }
+}
+
+static bool CheckPwd(const string& fname) {
+    ifstream ifs(fname);
+    if (!ifs) throw runtime_error("Can not open " + fname + "\n");
+    map<string, vector<pair<double, double>>> refs;
+    string line;
+    while (getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream is(line);
+        string name;
+        double td, p;
+        if (!(is >> name >> td >> p)) throw runtime_error("Bad line in " + fname + ": " + line + "\n");
+        refs[name].push_back({td, p});
+    }
+    PrintHeader("pwd: max relative error by decade of td", TD_DEC_MIN, TD_DEC_MAX);
+    bool ok = true;
+    for (auto& c: Cases()) {
+        auto it = refs.find(c.name);
+        if (it == refs.end()) {
+            cout << c.name << ": no reference curve\n";
+            continue;
+        }
+        unique_ptr<LaplWell> well = c.make();
+        well->SetAsymptoteTolerance(ASYMPT_TOL);
+        map<int, double> errs, errs_full;
+        for (auto& r: it->second) {
+            int dec = static_cast<int>(floor(log10(r.first) + 1e-9));
+            errs[dec] = max(errs[dec], RelErr(well->pwd(r.first), r.second));
+            errs_full[dec] = max(errs_full[dec], RelErr(well->pwd_full(r.first), r.second));
+        }
+        PrintRow(c.name, errs, TD_DEC_MIN, TD_DEC_MAX);
+        PrintRow("  full", errs_full, TD_DEC_MIN, TD_DEC_MAX);
+        for (auto* e: {&errs, &errs_full}) {
+            for (auto& de: *e) {
+                if (de.second > (de.first < 0 ? c.tol_early : c.tol)) {
+                    cout << "  above tolerance in the decade of td = 1e" << de.first << "\n";
+                    ok = false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+//---LaplWell::pd_m_parallel---------
+
+static bool CheckSymmetry() {
+    // a centred fracture is folded onto a quarter of its area, the unfolded grid is the reference;
+    // the points are mirror pairs about the centre, the line of the fracture included
+    vector<double> xs, ys{5.};
+    for (int i = 0; i < 20; ++i) {
+        xs.push_back(0.25 + 0.5*i);
+        ys.push_back(0.25 + 0.5*i);
+    }
+    const vector<pair<string, Boundary>> cases = {{"frac_nnnn_fcd10", Boundary::NNNN}, {"frac_cccc_fcd10", Boundary::CCCC}};
+    PrintHeader("pd_m_parallel: max difference of the symmetric grid relative to max pd, by decade of td", SYM_DEC_MIN, SYM_DEC_MAX);
+    double emax = 0.;
+    for (auto& c: cases) {
+        Rectangular::Fracture well(c.second, 5., 10., 5., 10., 10.);
+        GridSymmetry sym = well.symmetry();
+        if (!sym.x || !sym.y)
+            throw runtime_error(c.first + ": the fracture is not symmetric in x and y\n");
+        map<int, double> errs;
+        for (int dec = SYM_DEC_MIN; dec <= SYM_DEC_MAX; ++dec) {
+            double td = pow(10., dec);
+            Matrix3DV folded = MakeGrid(xs, ys), full = MakeGrid(xs, ys);
+            well.pd_m_parallel(td, 4, folded, true);
+            well.pd_m_parallel(td, 4, full, false);
+            double scale = 0., diff = 0.;
+            auto it = full.begin();
+            for (const auto& p: folded) {
+                scale = max(scale, abs(it->val));
+                diff = max(diff, abs(p.val - it->val));
+                ++it;
+            }
+            errs[dec] = diff/scale;
+        }
+        emax = max(emax, PrintRow(c.first, errs, SYM_DEC_MIN, SYM_DEC_MAX));
+    }
+    return emax <= SYM_TOL;
+}
+
+//---TypeCurveLibrary---------
+
+static vector<double> LogSpaced(const double lo, const double hi, const int n) {
+    vector<double> ans(n);
+    for (int i = 0; i < n; ++i)
+        ans[i] = lo*pow(hi/lo, static_cast<double>(i)/(n - 1));
+    return ans;
+}
+
+static void BuildTypeCurves(const string& fname) {
+    // the library file of WellController: centred fractures, Fcd at 6 per decade, xed and yed at 4 per doubling,
+    // td as the pwd check; 7 s a node, about two hours on TC_THREADS
+    TypeCurveLibrary lib(LogSpaced(1., 1000., 19), LogSpaced(4., 32., 13), LogSpaced(4., 32., 13), {0.5}, {0.5}, TdGrid());
+    cout << lib.NNodes() << " nodes" << endl;
+    lib.Build(TC_THREADS);
+    lib.Save(fname);
+}
+
+static double MaxRelErr(const vector<double>& vals, const vector<double>& tds, const function<double(double)>& exact) {
+    double ans = 0.;
+    for (size_t i = 0; i < tds.size(); ++i)
+        ans = max(ans, RelErr(vals[i], exact(tds[i])));
+    return ans;
+}
+
+static bool CheckTypeCurves() {
+    // a coarse lattice saved and read back, lookups between its nodes are checked against the exact solver
+    // with their own error estimate as the bound, those outside it or above max_err against the fallback;
+    // qwd falls exponentially once the boundaries are felt, which log td does not interpolate, so it stops at td = 1
+    vector<double> tds, tds_pwd, tds_qwd;
+    for (int j = -6; j <= 6; ++j) {
+        tds.push_back(pow(10., j/3.));
+        if (j < 6) tds_pwd.push_back(pow(10., j/3. + 1./6.));
+        if (j < 0) tds_qwd.push_back(pow(10., j/3. + 1./6.));
+    }
+    TypeCurveLibrary built({3., 10., 30.}, {4., 6., 9.}, {4., 6., 9.}, {0.5}, {0.5}, tds);
+    built.Build(TC_THREADS);
+    const string fname = "typecurves_check.bin";
+    built.Save(fname);
+    TypeCurveLibrary lib(fname);
+    remove(fname.c_str());
+    struct TcCase {
+        string name;
+        FractureParams p;
+        double max_err;
+        bool table; // expected to come from the table
+    };
+    const vector<TcCase> cases = {
+        {"tc_between_nodes", {5., 5., 7.5, 2.5, 3.75}, TC_CHECK_ERR, true},
+        {"tc_between_nodes_2", {20., 8., 4.5, 4., 2.25}, TC_CHECK_ERR, true},
+        {"tc_outside", {100., 6., 6., 3., 3.}, TC_CHECK_ERR, false},
+        {"tc_above_max_err", {5., 5., 7.5, 2.5, 3.75}, 1e-6, false}
+    };
+    cout << "\nTypeCurveLibrary: max relative error of the lookups, td from 1e-2 to 1e2 for pwd and to 1 for qwd\n"
+         << setw(22) << left << "" << right << setw(10) << "pwd" << setw(10) << "bound" << setw(10) << "error"
+         << setw(10) << "qwd" << setw(10) << "bound" << setw(10) << "error" << "\n";
+    bool ok = true;
+    for (auto& c: cases) {
+        Rectangular::Fracture well(Boundary::NNNN, c.p.xwd, c.p.xed, c.p.ywd, c.p.yed, c.p.Fcd);
+        TypeCurve pw = lib.pwd(c.p, tds_pwd, TC_THREADS, c.max_err), qw = lib.qwd(c.p, tds_qwd, TC_THREADS, c.max_err);
+        double epw = MaxRelErr(pw.vals, tds_pwd, [&](double td) { return well.pwd_full(td); });
+        double eqw = MaxRelErr(qw.vals, tds_qwd, [&](double td) { return well.qwd(td); });
+        cout << setw(22) << left << c.name << right << scientific << setprecision(1);
+        for (auto& r: {make_pair(&pw, epw), make_pair(&qw, eqw)})
+            cout << setw(10) << (r.first->exact ? "exact" : "table") << setw(10) << r.first->err << setw(10) << r.second;
+        cout << "\n" << defaultfloat;
+        for (auto& r: {make_tuple("pwd", &pw, epw), make_tuple("qwd", &qw, eqw)}) {
+            const TypeCurve& tc = *get<1>(r);
+            if (get<2>(r) > (tc.exact ? TC_EXACT_TOL : tc.err)) {
+                cout << "  " << get<0>(r) << " above the bound\n";
+                ok = false;
+            }
+            if (tc.exact == c.table) {
+                cout << "  " << get<0>(r) << " is expected " << (c.table ? "from the table" : "from the exact solver") << "\n";
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc == 3 && strcmp(argv[1], "--generate") == 0) {
+            Generate(argv[2]);
+            return 0;
+        }
+        if (argc == 3 && strcmp(argv[1], "--typecurves") == 0) {
+            BuildTypeCurves(argv[2]);
+            return 0;
+        }
+        if (argc != 2) {
+            cerr << "Usage: accuracy pwd_reference.txt | accuracy --generate pwd_reference.txt"
+                    " | accuracy --typecurves fracture_typecurves.bin\n";
+            return 2;
+        }
+        bool ok = CheckBess();
+        ok = CheckPwd(argv[1]) && ok;
+        ok = CheckSymmetry() && ok;
+        ok = CheckTypeCurves() && ok;
+        cout << "\n" << (ok ? "All errors are within tolerance" : "Errors above tolerance") << "\n";
+        return ok ? 0 : 1;
+    } catch (const exception& e) {
+        cerr << e.what();
+        return 2;
+    }
+}
@@ -0,0 +1,28 @@
+# Accuracy report of the numerical core against quadruple precision Bessel references and
+# stored pwd reference curves, builds without Qt:
+# qmake accuracy.pro && make && ./accuracy pwd_reference.txt
+# ./accuracy --generate pwd_reference.txt rewrites the curves (Gaver-Wynn-Rho inversion of pwd_lapl)
+# ./accuracy --typecurves fracture_typecurves.bin builds the type curve library of the application
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    accuracy.cpp \
+    ../adaptivegrid.cpp \
+    ../chbessel.cpp \
+    ../gwell.cpp \
+    ../interp_1d.cpp \
+    ../matrix3dv.cpp \
+    ../profiler.cpp \
+    ../qgaus.cpp \
+    ../treecode.cpp \
+    ../typecurves.cpp
+
+INCLUDEPATH += \
+    .. \
+    C:/mingw64/mingw64/lib/gcc/x86_64-w64-mingw32/8.1.0/include
+
+LIBS += -lquadmath -pthread
+
+QMAKE_CXXFLAGS_RELEASE += -O2
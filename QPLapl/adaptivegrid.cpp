@@ -0,0 +1,125 @@
+#include "adaptivegrid.h"
+
+using namespace std;
+
+AdaptiveGrid2D::AdaptiveGrid2D(const std::vector<double>& xs, const std::vector<double>& ys, const double z,
+        const double tol, const size_t coarse_step, const int max_level):
+    z(z), tol(tol), max_level(max_level), cxs(Coarsen(xs, coarse_step)), cys(Coarsen(ys, coarse_step)) {
+    assert(cxs.size() > 1 && cys.size() > 1);
+    for (size_t i = 0; i + 1 < cxs.size(); ++i) {
+        for (size_t j = 0; j + 1 < cys.size(); ++j) {
+            cells.push_back({cxs[i], cxs[i+1], cys[j], cys[j+1], 0, -1});
+        }
+    }
+};
+
+void AdaptiveGrid2D::Refine(const BatchFunc& func) {
+    vector<Key> pts;
+    for (double x: cxs)
+        for (double y: cys)
+            pts.push_back({x, y});
+    Evaluate(pts, func);
+    double scale = 0.;
+    for (const auto& v: vals)
+        scale = max(scale, abs(v.second));
+    if (scale == 0.) scale = 1.;
+    vector<size_t> active(cells.size());
+    for (size_t i = 0; i < active.size(); ++i) active[i] = i;
+    while (!active.empty()) {
+        pts.clear();
+        for (size_t c: active) {
+            if (cells[c].level < max_level)
+                pts.push_back({0.5*(cells[c].x1+cells[c].x2), 0.5*(cells[c].y1+cells[c].y2)});
+        }
+        Evaluate(pts, func);
+        vector<size_t> next_active;
+        pts.clear();
+        for (size_t c: active) {
+            if (cells[c].level >= max_level) continue;
+            const Cell cell = cells[c];
+            double xm = 0.5*(cell.x1+cell.x2), ym = 0.5*(cell.y1+cell.y2);
+            double pred = 0.25*(Val(cell.x1, cell.y1)+Val(cell.x1, cell.y2)+Val(cell.x2, cell.y1)+Val(cell.x2, cell.y2));
+            if (abs(Val(xm, ym) - pred) <= tol*scale) continue;
+            cells[c].child = static_cast<int>(cells.size());
+            for (const auto& xx: {make_pair(cell.x1, xm), make_pair(xm, cell.x2)}) {
+                for (const auto& yy: {make_pair(cell.y1, ym), make_pair(ym, cell.y2)}) {
+                    next_active.push_back(cells.size());
+                    cells.push_back({xx.first, xx.second, yy.first, yy.second, cell.level+1, -1});
+                }
+            }
+            pts.push_back({xm, cell.y1});
+            pts.push_back({xm, cell.y2});
+            pts.push_back({cell.x1, ym});
+            pts.push_back({cell.x2, ym});
+        }
+        Evaluate(pts, func);
+        active = move(next_active);
+    }
+}
+
+double AdaptiveGrid2D::Interpolate(const double x, const double y) const {
+    const Cell& c = cells[FindLeaf(x, y)];
+    double tx = (x - c.x1)/(c.x2 - c.x1);
+    double ty = (y - c.y1)/(c.y2 - c.y1);
+    return (1.-tx)*((1.-ty)*Val(c.x1, c.y1) + ty*Val(c.x1, c.y2)) + tx*((1.-ty)*Val(c.x2, c.y1) + ty*Val(c.x2, c.y2));
+}
+
+void AdaptiveGrid2D::Resample(Matrix3DV& grid, size_t zInd) const {
+    auto dims = grid.GetDimentions();
+    for (size_t i = 0; i < dims.nx; ++i) {
+        for (size_t j = 0; j < dims.ny; ++j) {
+            grid(i,j,zInd).val = Interpolate(grid(i,j,zInd).x, grid(i,j,zInd).y);
+        }
+    }
+}
+
+size_t AdaptiveGrid2D::NEvaluations() const {
+    return vals.size();
+}
+
+size_t AdaptiveGrid2D::NLeaves() const {
+    return count_if(cells.begin(), cells.end(), [](const Cell& c) {return c.child < 0;});
+}
+
+std::vector<double> AdaptiveGrid2D::Coarsen(const std::vector<double>& v, const size_t step) const {
+    vector<double> ans;
+    for (size_t i = 0; i < v.size(); i += step)
+        ans.push_back(v[i]);
+    if (!v.empty() && ans.back() != v.back())
+        ans.push_back(v.back());
+    return ans;
+}
+
+void AdaptiveGrid2D::Evaluate(const std::vector<Key>& pts, const BatchFunc& func) {
+    vector<Key> fresh;
+    for (const auto& p: pts) {
+        if (vals.count(p) == 0)
+            fresh.push_back(p);
+    }
+    sort(fresh.begin(), fresh.end());
+    fresh.erase(unique(fresh.begin(), fresh.end()), fresh.end());
+    if (fresh.empty()) return;
+    Matrix3DV batch(fresh.size(), 1, 1);
+    for (size_t i = 0; i < fresh.size(); ++i)
+        batch(i,0) = {fresh[i].first, fresh[i].second, z};
+    func(batch);
+    for (size_t i = 0; i < fresh.size(); ++i)
+        vals[fresh[i]] = batch(i,0).val;
+}
+
+double AdaptiveGrid2D::Val(const double x, const double y) const {
+    return vals.at({x, y});
+}
+
+size_t AdaptiveGrid2D::FindLeaf(const double x, const double y) const {
+    auto locate = [](const vector<double>& v, const double t) {
+        size_t i = upper_bound(v.begin(), v.end(), t) - v.begin();
+        return min(max(i, size_t(1)), v.size()-1) - 1;
+    };
+    size_t c = locate(cxs, x)*(cys.size()-1) + locate(cys, y);
+    while (cells[c].child >= 0) {
+        const Cell& cell = cells[c];
+        c = cells[c].child + 2*(x >= 0.5*(cell.x1+cell.x2)) + (y >= 0.5*(cell.y1+cell.y2));
+    }
+    return c;
+}
@@ -0,0 +1,50 @@
+#ifndef ADAPTIVEGRID_H
+#define ADAPTIVEGRID_H
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "matrix3dv.h"
+
+static const double ADAPT_EPS = 1e-3; // relative interpolation error that triggers cell splitting
+static const size_t ADAPT_COARSE_STEP = 8; // every ADAPT_COARSE_STEP-th node of the target grid goes to the coarse grid
+static const int ADAPT_MAX_LEVEL = 3; // max number of quadtree splits of a coarse cell, 2^ADAPT_MAX_LEVEL == ADAPT_COARSE_STEP
+
+class AdaptiveGrid2D {
+    // Quadtree sampling of a scalar field on the plane z = const.
+    // Starts from a coarse tensor grid, estimates bilinear interpolation error of every cell
+    // at its center and splits only the cells where the error is larger than tol*max|val|.
+    // The field is evaluated by batches: func receives a Matrix3DV of points and fills their vals.
+public:
+    using BatchFunc = std::function<void(Matrix3DV&)>;
+    AdaptiveGrid2D(const std::vector<double>& xs, const std::vector<double>& ys, const double z,
+            const double tol = ADAPT_EPS, const size_t coarse_step = ADAPT_COARSE_STEP,
+            const int max_level = ADAPT_MAX_LEVEL);
+    void Refine(const BatchFunc& func);
+    double Interpolate(const double x, const double y) const; // bilinear interpolation over the leaf containing (x, y)
+    void Resample(Matrix3DV& grid, size_t zInd = 0) const; // fills vals of z-slice zInd of a tensor grid
+    size_t NEvaluations() const;
+    size_t NLeaves() const;
+private:
+    struct Cell {
+        double x1, x2, y1, y2;
+        int level;
+        int child; // index of the first of four children in cells, -1 for leaves
+    };
+    using Key = std::pair<double, double>;
+    const double z, tol;
+    const int max_level;
+    std::vector<double> cxs, cys; // coarse grid
+    std::vector<Cell> cells; // first (cxs.size()-1)*(cys.size()-1) cells are the coarse ones
+    std::map<Key, double> vals;
+    std::vector<double> Coarsen(const std::vector<double>& v, const size_t step) const;
+    void Evaluate(const std::vector<Key>& pts, const BatchFunc& func);
+    double Val(const double x, const double y) const;
+    size_t FindLeaf(const double x, const double y) const;
+};
+
+#endif // ADAPTIVEGRID_H
@@ -0,0 +1,24 @@
+# Google Benchmark suite of the numerical core, builds without Qt:
+# qmake bench.pro && make && ./bench --benchmark_out=baseline.json --benchmark_out_format=json
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    bench_core.cpp \
+    ../adaptivegrid.cpp \
+    ../chbessel.cpp \
+    ../gwell.cpp \
+    ../interp_1d.cpp \
+    ../matrix3dv.cpp \
+    ../profiler.cpp \
+    ../qgaus.cpp \
+    ../treecode.cpp
+
+INCLUDEPATH += \
+    .. \
+    C:/mingw64/mingw64/lib/gcc/x86_64-w64-mingw32/8.1.0/include
+
+LIBS += -lbenchmark -lquadmath -pthread
+
+QMAKE_CXXFLAGS_RELEASE += -O2
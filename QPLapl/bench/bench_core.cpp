@@ -0,0 +1,283 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include "gwell.h"
+#include "matrix3dv.h"
+
+using namespace std;
+
+// The u values stand for early, middle and late td of a unit fracture, td = ln(2)/u.
+// Geometry of the kernels and wells: fracture in the middle of a 100 x 100 impermeable square, Fcd = 10.
+
+static const double XWD = 50., XED = 100., YWD = 50., YED = 100., FCD = 10.;
+
+static double ArgU(const benchmark::State& state) {
+    return pow(10., static_cast<double>(state.range(0)));
+}
+
+//---FastBessel::Bess---------
+
+static const FastBessel::Bess& Bessel() {
+    return FastBessel::Bess::Shared();
+}
+
+static void BM_BessK0(benchmark::State& state, const double x) {
+    const FastBessel::Bess& bess = Bessel();
+    for (auto _: state)
+        benchmark::DoNotOptimize(bess.k0(x));
+}
+BENCHMARK_CAPTURE(BM_BessK0, x_le_1, 0.5);
+BENCHMARK_CAPTURE(BM_BessK0, x_gt_1, 5.);
+
+static void BM_BessIK00x(benchmark::State& state, const double x) {
+    const FastBessel::Bess& bess = Bessel();
+    for (auto _: state)
+        benchmark::DoNotOptimize(bess.ik00x(x));
+}
+BENCHMARK_CAPTURE(BM_BessIK00x, power, 0.5);
+BENCHMARK_CAPTURE(BM_BessIK00x, chebyshev, 5.);
+
+static void BM_BessIK0ab(benchmark::State& state, const double x1, const double x2) {
+    const FastBessel::Bess& bess = Bessel();
+    for (auto _: state)
+        benchmark::DoNotOptimize(bess.ik0ab(x1, x2));
+}
+BENCHMARK_CAPTURE(BM_BessIK0ab, power_power, 0.05, 1.5);
+BENCHMARK_CAPTURE(BM_BessIK0ab, power_chebyshev, 1., 5.);
+BENCHMARK_CAPTURE(BM_BessIK0ab, chebyshev_chebyshev, 3., 8.);
+BENCHMARK_CAPTURE(BM_BessIK0ab, gauss, 0.5, 0.7);
+
+//---Rectangular::Well kernels---------
+
+class KernelProbe: public Rectangular::Well {
+    // the protected kernels of Rectangular::Well, the linear system is not used
+public:
+    double pd_lapl(const double, const double, const double, const double = 0.) const override { return 0.; }
+    double pwd_lapl(const double) const override { return 0.; }
+    double qwd_lapl(const double) const override { return 0.; }
+    void if2e(const double u, Eigen::MatrixXd& matrix, Eigen::VectorXd& buf) const {
+        fill_if2e<Boundary::NNNN, double>(u, XWD, XED, XED, YWD, YED, 0., matrix, buf);
+    }
+    void i1f2h(const double u, Eigen::MatrixXd& matrix, Eigen::VectorXd& buf) const {
+        fill_i1f2h<Boundary::NNNN, double>(u, XWD, XED, XED, 0., matrix, buf);
+    }
+    void i1f2h_yd(const double u, const double yd, Eigen::VectorXd& buf) const {
+        vect_i1f2h_yd<Boundary::NNNN>(u, XWD + 0.3, XWD, XED, XED, yd, YWD, 0., buf);
+    }
+private:
+    Eigen::MatrixXd MakeMatrix(const double) const override { return {}; }
+    Eigen::VectorXd MakeRhs(const double) const override { return {}; }
+    Eigen::MatrixXd MakeSrcMatrix() const override { return {}; }
+    Eigen::VectorXd MakeGreenVector(const double, const double, const double, const double = 0.) const override { return {}; }
+};
+
+static void BM_FillIf2e(benchmark::State& state) {
+    KernelProbe probe;
+    Eigen::MatrixXd matrix(2*Rectangular::NSEG, 2*Rectangular::NSEG);
+    Eigen::VectorXd buf(2*Rectangular::NSEG);
+    const double u = ArgU(state);
+    for (auto _: state) {
+        probe.if2e(u, matrix, buf);
+        benchmark::DoNotOptimize(matrix.data());
+    }
+}
+BENCHMARK(BM_FillIf2e)->DenseRange(-3, 3, 3)->Unit(benchmark::kMicrosecond);
+
+static void BM_FillI1f2h(benchmark::State& state) {
+    KernelProbe probe;
+    Eigen::MatrixXd matrix(2*Rectangular::NSEG, 2*Rectangular::NSEG);
+    Eigen::VectorXd buf(2*Rectangular::NSEG);
+    const double u = ArgU(state);
+    for (auto _: state) {
+        probe.i1f2h(u, matrix, buf);
+        benchmark::DoNotOptimize(matrix.data());
+    }
+}
+BENCHMARK(BM_FillI1f2h)->DenseRange(-3, 3, 3)->Unit(benchmark::kMicrosecond);
+
+static void BM_VectI1f2hYd(benchmark::State& state) {
+    // a point on the fracture line and one off it, which takes the Romberg integrals
+    KernelProbe probe;
+    Eigen::VectorXd buf(2*Rectangular::NSEG);
+    const double u = ArgU(state);
+    const double yd = YWD + (state.range(1) ? 0.2 : 0.);
+    for (auto _: state) {
+        probe.i1f2h_yd(u, yd, buf);
+        benchmark::DoNotOptimize(buf.data());
+    }
+}
+BENCHMARK(BM_VectI1f2hYd)->ArgsProduct({{-3, 0, 3}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+//---Rectangular::Fracture---------
+
+static const Rectangular::Fracture& Frac() {
+    static const Rectangular::Fracture frac(Boundary::NNNN, XWD, XED, YWD, YED, FCD);
+    return frac;
+}
+
+static void BM_FracturePwdLapl(benchmark::State& state) {
+    const Rectangular::Fracture& frac = Frac();
+    const double u = ArgU(state);
+    for (auto _: state)
+        benchmark::DoNotOptimize(frac.pwd_lapl(u));
+}
+BENCHMARK(BM_FracturePwdLapl)->DenseRange(-3, 3, 3)->Unit(benchmark::kMillisecond);
+
+static void BM_WellConstruct(benchmark::State& state) {
+    // the Bess tables are shared, a well builds its source matrix only
+    Bessel();
+    for (auto _: state) {
+        Rectangular::MultiFractured well(Boundary::NNNN, XWD, XED, {YWD - 10., YWD, YWD + 10.}, YED, FCD);
+        benchmark::DoNotOptimize(&well);
+    }
+}
+BENCHMARK(BM_WellConstruct)->Unit(benchmark::kMicrosecond);
+
+static void BM_FracturePdLapl(benchmark::State& state) {
+    const Rectangular::Fracture& frac = Frac();
+    const double u = ArgU(state);
+    for (auto _: state)
+        benchmark::DoNotOptimize(frac.pd_lapl(u, XWD + 0.5, YWD + 0.5));
+}
+BENCHMARK(BM_FracturePdLapl)->DenseRange(-3, 3, 3)->Unit(benchmark::kMillisecond);
+
+//---LaplWell---------
+
+static void BM_Pwd(benchmark::State& state) {
+    // the asymptotes take over at the ends of the td range, their crossovers are found before the timing
+    static Rectangular::Fracture frac(Boundary::NNNN, XWD, XED, YWD, YED, FCD);
+    frac.SetAsymptoteTolerance(ASYMPT_TOL);
+    const double td = pow(10., static_cast<double>(state.range(0)));
+    frac.pwd(td);
+    for (auto _: state)
+        benchmark::DoNotOptimize(frac.pwd(td));
+}
+BENCHMARK(BM_Pwd)->DenseRange(-4, 6, 2)->Unit(benchmark::kMillisecond);
+
+static void BM_PwdFull(benchmark::State& state) {
+    const Rectangular::Fracture& frac = Frac();
+    const double td = pow(10., static_cast<double>(state.range(0)));
+    for (auto _: state)
+        benchmark::DoNotOptimize(frac.pwd_full(td));
+}
+BENCHMARK(BM_PwdFull)->DenseRange(-4, 6, 2)->Unit(benchmark::kMillisecond);
+
+static void BM_FractureSweep(benchmark::State& state) {
+    // an Fcd sweep of range(0) cases over a decade schedule, the sweep against one Fracture per case
+    const int n = state.range(0);
+    vector<Rectangular::FractureCase> cases;
+    for (int i = 0; i < n; ++i)
+        cases.push_back({XWD, XED, YWD, YED, pow(10., -1. + 4.*i/n)});
+    vector<double> tds;
+    for (int e = -4; e <= 6; ++e)
+        tds.push_back(pow(10., static_cast<double>(e)));
+    for (auto _: state) {
+        if (state.range(1)) {
+            Rectangular::FractureSweep sweep(Boundary::NNNN, cases);
+            benchmark::DoNotOptimize(sweep.pwd(tds, 4));
+        } else {
+            for (const auto& c: cases) {
+                Rectangular::Fracture frac(Boundary::NNNN, c.xwd, c.xed, c.ywd, c.yed, c.Fcd);
+                vector<double> pwds(tds.size());
+                frac.pwd_parallel(tds, pwds, 4);
+                benchmark::DoNotOptimize(pwds);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*n);
+}
+BENCHMARK(BM_FractureSweep)->ArgsProduct({{8, 32}, {0, 1}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_PdMParallel(benchmark::State& state) {
+    // n x n points around the fracture off its symmetry planes, so no point is folded
+    const Rectangular::Fracture& frac = Frac();
+    const int n = state.range(0);
+    const int nthreads = state.range(1);
+    vector<double> xs(n), ys(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = XWD + 0.1 + 4.*i/n;
+        ys[i] = YWD + 0.1 + 4.*i/n;
+    }
+    for (auto _: state) {
+        Matrix3DV grid = frac.pd_m_parallel(1., nthreads, xs, ys);
+        benchmark::DoNotOptimize(grid.GetMaxVal());
+    }
+    state.SetItemsProcessed(state.iterations()*n*n);
+}
+BENCHMARK(BM_PdMParallel)->ArgsProduct({{4, 8, 16}, {1, 2, 4}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_PdMLowRank(benchmark::State& state) {
+    // the grid of BM_PdMParallel with one solve per transform and the far field in cross approximations
+    static Rectangular::Fracture frac(Boundary::NNNN, XWD, XED, YWD, YED, FCD);
+    frac.SetLowRankTolerance(LR_EPS);
+    const int n = state.range(0);
+    vector<double> xs(n), ys(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = XWD + 0.1 + 4.*i/n;
+        ys[i] = YWD + 0.1 + 4.*i/n;
+    }
+    for (auto _: state) {
+        Matrix3DV grid = frac.pd_m_parallel(1., 4, xs, ys);
+        benchmark::DoNotOptimize(grid.GetMaxVal());
+    }
+    state.SetItemsProcessed(state.iterations()*n*n);
+}
+BENCHMARK(BM_PdMLowRank)->Arg(16)->Arg(32)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_PdMTreecode(benchmark::State& state) {
+    // the grid of BM_PdMLowRank summed by the K0 treecode over the image sources
+    static Rectangular::Fracture frac(Boundary::NNNN, XWD, XED, YWD, YED, FCD);
+    frac.SetTreecodeTolerance(TREE_EPS);
+    const int n = state.range(0);
+    vector<double> xs(n), ys(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = XWD + 0.1 + 4.*i/n;
+        ys[i] = YWD + 0.1 + 4.*i/n;
+    }
+    for (auto _: state) {
+        Matrix3DV grid = frac.pd_m_parallel(1., 4, xs, ys);
+        benchmark::DoNotOptimize(grid.GetMaxVal());
+    }
+    state.SetItemsProcessed(state.iterations()*n*n);
+}
+BENCHMARK(BM_PdMTreecode)->Arg(16)->Arg(32)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//---Matrix3DV---------
+
+static Matrix3DV FilledGrid(const int n) {
+    vector<double> xs(n), ys(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = i;
+        ys[i] = 0.5*i;
+    }
+    Matrix3DV grid = MakeGrid(xs, ys);
+    for (auto& p: grid)
+        p.val = p.x*p.y + 0.125;
+    return grid;
+}
+
+static void BM_Matrix3DVWrite(benchmark::State& state) {
+    const Matrix3DV grid = FilledGrid(state.range(0));
+    const string fname = "bench_matrix3dv.txt";
+    for (auto _: state) {
+        ofstream ofs(fname);
+        ofs << grid;
+    }
+    remove(fname.c_str());
+}
+BENCHMARK(BM_Matrix3DVWrite)->Arg(64)->Arg(256)->Unit(benchmark::kMillisecond);
+
+static void BM_Matrix3DVRead(benchmark::State& state) {
+    const string fname = "bench_matrix3dv.txt";
+    {
+        ofstream ofs(fname);
+        ofs << FilledGrid(state.range(0));
+    }
+    for (auto _: state) {
+        Matrix3DV grid(fname);
+        benchmark::DoNotOptimize(grid.size());
+    }
+    remove(fname.c_str());
+}
+BENCHMARK(BM_Matrix3DVRead)->Arg(64)->Arg(256)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
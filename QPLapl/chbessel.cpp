@@ -1,4 +1,5 @@
 #include "chbessel.h"
+#include "profiler.h"
 
 using namespace std;
 
@@ -8,10 +9,19 @@ namespace FastBessel {
 
 Bess::Bess(const bool fast, const int n, const int m, const double dd): is_fast(fast), d(dd), N(n), M(m),
         ak(fak(N, N, d)), ck(fck(M, M, d, 0.)),
-        coef(_coef()), ns(_ns()), xgs(GAUSS_POINTS), wgs(GAUSS_POINTS) {
+        coef(_coef()), ns(_ns()),
+        i0pwr(_ipwr(0)), i1pwr(_ipwr(1)), k1pwr(_k1pwr()),
+        i0ch(fik(N_IK1, DI, 0, true)), i1ch(fik(N_IK1, DI, 1, true)), k1ch(fik(N_IK1, d, 1, false)),
+        xgs(GAUSS_POINTS), wgs(GAUSS_POINTS) {
     gauleg(-1., 1., xgs, wgs);
 };
 
+const Bess& Bess::Shared() {
+    // a function-local static is initialized once even under concurrent first calls
+    static const Bess bess(false);
+    return bess;
+}
+
 double Bess::abs_ik0ab(const double x1, const double x2) const {
     if (x1 >= 0) {
         return ik0ab(x1, x2);
@@ -81,6 +91,7 @@ double Bess::ik0ab_num(const double x1, const double x2) const {
 double Bess::ik0ab(const double x1, const double x2) const {
     if (x1 <= 0.1 || (x2-x1) > 0.5) {
         if (x2 < d) {
+            PROFILE_COUNT(ProfKernel::Ik0abPower, calls, 1);
             if (x1 < 0. || x2 < 0.) throw invalid_argument("in Bess::ik0ab(x): x < 0");
             long double sum1 = 0., sum2 = 0.;
             if (x1>0.) {
@@ -91,6 +102,8 @@ double Bess::ik0ab(const double x1, const double x2) const {
             }
             return sum2 - sum1;
         } else if (x1 < d && x2 >= d) {
+            PROFILE_COUNT(ProfKernel::Ik0abPower, calls, 1);
+            PROFILE_COUNT(ProfKernel::Ik0abChebyshev, calls, 1);
             long double sum1 = 0.;
             if (x1 > 0.) {
                 POWER_SUM(x1, sum1);
@@ -103,6 +116,7 @@ double Bess::ik0ab(const double x1, const double x2) const {
             }
             return (PI2 - sum1) - exp(-x2)/sqrt(x2)*sum2;
         } else {
+            PROFILE_COUNT(ProfKernel::Ik0abChebyshev, calls, 1);
             double sum1 = 0., sum2 = 0.;
             if (is_fast) {
                 FAST_CHEB_SUM(x1, sum1);
@@ -114,6 +128,7 @@ double Bess::ik0ab(const double x1, const double x2) const {
             return exp(-x1)/sqrt(x1)*sum1 - exp(-x2)/sqrt(x2)*sum2;
         }
     } else {
+        PROFILE_COUNT(ProfKernel::Ik0abGauss, calls, 1);
         double __xm, __xr, __s, __dx;
         __xm=0.5*(x2+x1);
         __xr=0.5*(x2-x1);
@@ -158,6 +173,72 @@ double Bess::k0(const double x) const {
     }
 }
 
+double Bess::i0(const double x) const {
+    double ax = abs(x);
+    if (ax < DI) {
+        double y = 0.25*x*x;
+        double ans = i0pwr[MAXIT_IBESS-1];
+        for (int i = MAXIT_IBESS-2; i >= 0; --i) {
+            ans = ans*y + i0pwr[i];
+        }
+        return ans;
+    }
+    return exp(ax)*cheb_sum(i0ch, 2.*DI/ax-1.)/sqrt(ax);
+}
+
+double Bess::i1(const double x) const {
+    double ax = abs(x);
+    if (ax < DI) {
+        double y = 0.25*x*x;
+        double ans = i1pwr[MAXIT_IBESS-1];
+        for (int i = MAXIT_IBESS-2; i >= 0; --i) {
+            ans = ans*y + i1pwr[i];
+        }
+        return 0.5*x*ans;
+    }
+    double ans = exp(ax)*cheb_sum(i1ch, 2.*DI/ax-1.)/sqrt(ax);
+    return x < 0. ? -ans : ans;
+}
+
+double Bess::k1(const double x) const {
+    if (x <= 0.0) {
+        throw std::invalid_argument("x <= 0 in Bess::k1 " + std::to_string(x));
+    }
+    if (x < d) {
+        double y = 0.25*x*x;
+        double ans = k1pwr[MAXIT_IKBESS-1];
+        for (int i = MAXIT_IKBESS-2; i >= 0; --i) {
+            ans = ans*y + k1pwr[i];
+        }
+        return 1./x + log(0.5*x)*i1(x) - 0.25*x*ans;
+    }
+    return exp(-x)*cheb_sum(k1ch, 2.*d/x-1.)/sqrt(x);
+}
+
+double Bess::i0e(const double x) const {
+    double ax = abs(x);
+    if (ax < DI) return exp(-ax)*i0(ax);
+    return cheb_sum(i0ch, 2.*DI/ax-1.)/sqrt(ax);
+}
+
+double Bess::i1e(const double x) const {
+    double ax = abs(x);
+    if (ax < DI) return exp(-ax)*i1(x);
+    double ans = cheb_sum(i1ch, 2.*DI/ax-1.)/sqrt(ax);
+    return x < 0. ? -ans : ans;
+}
+
+double Bess::k0e(const double x) const {
+    if (x <= 1.0) return exp(x)*k0(x);
+    double z = 1.0/x;
+    return poly(k0pp,7,z)/(poly(k0qq,7,z)*sqrt(x));
+}
+
+double Bess::k1e(const double x) const {
+    if (x < d) return exp(x)*k1(x);
+    return cheb_sum(k1ch, 2.*d/x-1.)/sqrt(x);
+}
+
 //---PRIVATE---------
 const double Bess::k0pi[]={1.0,2.346487949187396e-1,1.187082088663404e-2,
 2.150707366040937e-4,1.425433617130587e-6};
@@ -183,6 +264,17 @@ inline double Bess::poly(const double* cof, const int n, const double x) const {
     return ans;
 }
 
+inline double Bess::cheb_sum(const std::vector<double>& cof, const double t) const {
+    // Clenshaw recurrence, the first coefficient is already halved
+    double b0 = 0., b1 = 0., b2;
+    for (int i = cof.size()-1; i >= 1; --i) {
+        b2 = b1;
+        b1 = b0;
+        b0 = 2.*t*b1 - b2 + cof[i];
+    }
+    return t*b0 - b1 + cof[0];
+}
+
 vector<long double> Bess::_coef() {
     vector<long double> ans(MAXIT_IKBESS);
     long double dum;
@@ -209,6 +301,90 @@ vector<long double> Bess::_ns() {
 
 
 
+vector<double> Bess::_ipwr(const int nu) {
+    // 1/(k!(k+nu)!), BesselI[nu,x] = (x/2)^nu*sum of them times (x/2)^2k
+    vector<double> ans(MAXIT_IBESS);
+    long double c = 1.;
+    ans[0] = c;
+    for (int k = 1; k < MAXIT_IBESS; ++k) {
+        c /= (long double)k*(k+nu);
+        ans[k] = c;
+    }
+    return ans;
+}
+
+vector<double> Bess::_k1pwr() {
+    // (psi(k+1)+psi(k+2))/(k!(k+1)!), Abramowitz and Stegun 9.6.11 for n = 1
+    vector<double> ans(MAXIT_IKBESS);
+    long double c = 1., h = 0.;
+    for (int k = 0; k < MAXIT_IKBESS; ++k) {
+        if (k > 0) {
+            c /= (long double)k*(k+1);
+            h += 1./(long double)k;
+        }
+        ans[k] = c*(2.*(h - EUL_GAMMA_LD) + 1./(k+1.));
+    }
+    return ans;
+}
+
+vector<double> Bess::fik(const int n, const double d, const int nu, const bool first_kind) {
+    // interpolation at the Chebyshev nodes of t = 2*d/x-1, the first coefficient is halved
+    vector<long double> sum(n, 0.L);
+    for (int k = 0; k < n; ++k) {
+        long double c = cosl(PI2*(k+0.5L)/n); // t+1 = 2c^2 without the cancellation near t = -1
+        long double t = 2.L*c*c-1.L;
+        long double f = sik(nu, first_kind, d/(c*c));
+        long double ch_0 = 1.L, ch_1 = t, ch_2;
+        sum[0] += f;
+        for (int j = 1; j < n; ++j) {
+            sum[j] += f*ch_1;
+            ch_2 = 2.L*t*ch_1 - ch_0;
+            ch_0 = ch_1;
+            ch_1 = ch_2;
+        }
+    }
+    vector<double> ans(n);
+    for (int j = 0; j < n; ++j) {
+        ans[j] = (j == 0 ? 1.L : 2.L)*sum[j]/n;
+    }
+    return ans;
+}
+
+long double Bess::sik(const int nu, const bool first_kind, const long double x) {
+    // I: the power series of positive terms below 30, the asymptotic series above,
+    // K: the trapezoidal rule for exp(x)*K = int_0^inf exp(-x(cosh(t)-1))cosh(nu*t)dt, which converges geometrically
+    // when the step resolves the peak width 1/sqrt(x)
+    const long double eps = 1e-22L;
+    if (first_kind) {
+        if (x < 30.L) {
+            long double y = 0.25L*x*x;
+            long double term = nu == 0 ? 1.L : 0.5L*x;
+            long double sum = term;
+            for (int k = 1; term > eps*sum; ++k) {
+                term *= y/((long double)k*(k+nu));
+                sum += term;
+            }
+            return sqrtl(x)*expl(-x)*sum;
+        }
+        long double mu = 4.L*nu*nu;
+        long double term = 1.L, sum = 1.L;
+        for (int k = 1; k < 2.L*x; ++k) {
+            term *= -(mu - (2.L*k-1.L)*(2.L*k-1.L))/(8.L*k*x);
+            sum += term;
+            if (fabsl(term) < eps*sum) break;
+        }
+        return sum/sqrtl(4.L*PI2);
+    }
+    long double h = min(0.1L, 0.25L/sqrtl(x));
+    long double sum = 0.5L, f = 1.L;
+    for (int k = 1; f > eps*sum; ++k) {
+        long double t = k*h;
+        f = expl(-x*(coshl(t)-1.L))*coshl(nu*t);
+        sum += f;
+    }
+    return sqrtl(x)*h*sum;
+}
+
 vector<double> Bess::fak(const int m, const int n, const double d) {
     vector<__float128> fq = fakq(m,n,(__float128)d, SQRT_PI2Q); // here scaling is used SQRT_PI2Q
     vector<double> ans(fq.size());
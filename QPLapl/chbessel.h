@@ -83,6 +83,7 @@ class Bess {
     // calculates modified bessel function of second kind and its integral using Chebyshev polynomial expansion
 public:
     Bess(const bool fast = false, const int n = 34, const int m = 34, const double dd = 2.);
+    static const Bess& Shared(); // the default tables, built on the first call and then read by every well and thread
     //-----------
     double ik00x_ch(const double x) const; // t: [0, x], chebyshev approximation for x >= d;
     long double ik00x_pwr(const double x) const; // t: [0, x], power approximation for t < d;
@@ -96,9 +97,20 @@ public:
     //-----------
     double _k0(const double x) const; // sqrt(x)*exp(x)*BesselK[0,x], x >= d;
     double k0(const double x) const; // BesselK[0,x], x >= d
+    //-----------
+    double i0(const double x) const; // BesselI[0,x]
+    double i1(const double x) const; // BesselI[1,x]
+    double k1(const double x) const; // BesselK[1,x]
+    double i0e(const double x) const; // exp(-x)*BesselI[0,x]
+    double i1e(const double x) const; // exp(-x)*BesselI[1,x]
+    double k0e(const double x) const; // exp(x)*BesselK[0,x]
+    double k1e(const double x) const; // exp(x)*BesselK[1,x]
 private:
     const int MAXIT_IKBESS=20;
     const int GAUSS_POINTS = 20;
+    const int MAXIT_IBESS = 26; // terms of the I0, I1 power series for x < DI
+    const int N_IK1 = 40; // Chebyshev terms of the scaled I0, I1 for x >= DI and K1 for x >= d
+    const double DI = 8.;
     const bool is_fast;
     const double d;
     const int N, M;
@@ -107,8 +119,14 @@ private:
     std::vector<double> fck(const int m, const int n, double d, double mu); // calculates coefficients of Chebyshev series for _ik0(x)
     std::vector<__float128> fakq(const int m, const int n, const __float128 d, const __float128 multt = 1.q); // same as fak but with quadruple presicion
     std::vector<__float128> fckq(const int m, const int n, const __float128 d, const __float128 mu, const __float128 multt = 1.q); // same as fck but with quadruple precision
+    std::vector<double> fik(const int n, const double d, const int nu, const bool first_kind); // calculates coefficients of Chebyshev series for sqrt(x)*exp(-+x)*BesselI|K[nu,x]
+    static long double sik(const int nu, const bool first_kind, const long double x); // sqrt(x)*exp(-+x)*BesselI|K[nu,x] for fik
+    std::vector<double> _ipwr(const int nu), _k1pwr();
+    inline double cheb_sum(const std::vector<double>& cof, const double t) const; // Clenshaw sum of a Chebyshev series, t: [-1, 1]
     const std::vector<double> ak, ck; // coefficients for constructor Bess()
     const std::vector<long double> coef, ns;
+    const std::vector<double> i0pwr, i1pwr, k1pwr; // power series in (x/2)^2 for x < DI (I0, I1) and x < d (K1)
+    const std::vector<double> i0ch, i1ch, k1ch; // Chebyshev series in 2*DI/x-1 (I0, I1) and 2*d/x-1 (K1)
     //BessK0 bess;
     //GaussIntegrator gs;
     std::vector<double> xgs, wgs; // gauss abscissas and weights
@@ -0,0 +1,171 @@
+#include "deconvolution.h"
+
+using namespace std;
+
+std::string DeconvReport::ToString() const {
+    ostringstream os;
+    os << (converged ? "Converged: " : "Not converged: ") << message << "\n";
+    os << "Iterations: " << iterations << ", rms: " << rms << ", curvature: " << curvature << "\n";
+    os << "Initial pressure: " << p0 << "\n";
+    return os.str();
+}
+
+Deconvolution::Deconvolution(const std::vector<double>& ts, const std::vector<double>& ps,
+        const std::vector<double>& ts_rate, const std::vector<double>& qs,
+        const double reg): ts(ts), ps(ps), reg(reg), p0(0.) {
+    if (ts.empty() || ts.size() != ps.size())
+        throw invalid_argument("Deconvolution: pressure series is empty or of different size\n");
+    if (ts_rate.empty() || ts_rate.size() != qs.size())
+        throw invalid_argument("Deconvolution: rate history is empty or of different size\n");
+    for (size_t i = 1; i < ts.size(); ++i)
+        if (ts[i] <= ts[i-1]) throw invalid_argument("Deconvolution: pressure times must increase\n");
+    for (size_t k = 1; k < ts_rate.size(); ++k)
+        if (ts_rate[k] <= ts_rate[k-1]) throw invalid_argument("Deconvolution: rate times must increase\n");
+    if (ts.front() <= 0.) throw invalid_argument("Deconvolution: pressure times must be positive\n");
+    MakeBasis(ts_rate, qs);
+};
+
+void Deconvolution::MakeBasis(const std::vector<double>& ts_rate, const std::vector<double>& qs) {
+    vector<pair<double, double>> steps; // (time, rate change)
+    for (size_t k = 0; k < qs.size(); ++k) {
+        double dq = k == 0 ? qs[0] : qs[k] - qs[k-1];
+        if (dq != 0.) steps.push_back({k == 0 ? 0. : ts_rate[k-1], dq});
+    }
+    if (steps.empty()) throw invalid_argument("Deconvolution: rate history is zero\n");
+    double lag_min = numeric_limits<double>::max();
+    size_t k = 0;
+    for (double t: ts) {
+        while (k < steps.size() && steps[k].first < t) ++k;
+        if (k > 0) lag_min = min(lag_min, t - steps[k-1].first);
+    }
+    double lag_max = ts.back() - steps.front().first;
+    if (lag_min > lag_max) throw invalid_argument("Deconvolution: no pressure measurements after the first rate step\n");
+    h = log(10.)/DECONV_NODES_PER_DECADE;
+    // a decade of nodes below the shortest lag carries the part of p_u accumulated before it,
+    // a decade above the longest one lets dp_u/dln(t) grow up to the end (left flanks of the bumps),
+    // the curvature term extrapolates z there
+    size_t m = static_cast<size_t>(ceil(log(lag_max/lag_min)/h)) + 2*DECONV_NODES_PER_DECADE + 1;
+    nodes.resize(m);
+    for (size_t j = 0; j < m; ++j)
+        nodes[j] = lag_min*exp((static_cast<double>(j) - DECONV_NODES_PER_DECADE)*h);
+    // for every node: Q is the current rate, S = sum of dq*exp(-(t-tau_k)/tau_m) is carried from step to step
+    basis.resize(ts.size(), m);
+    for (size_t j = 0; j < m; ++j) {
+        double q = 0., s = 0., t_prev = 0.;
+        k = 0;
+        for (size_t i = 0; i < ts.size(); ++i) {
+            while (k < steps.size() && steps[k].first < ts[i]) {
+                s = s*exp(-(steps[k].first - t_prev)/nodes[j]) + steps[k].second;
+                q += steps[k].second;
+                t_prev = steps[k].first;
+                ++k;
+            }
+            basis(i, j) = q - s*exp(-(ts[i] - t_prev)/nodes[j]);
+        }
+    }
+    z = Eigen::VectorXd::Zero(m);
+}
+
+DeconvReport Deconvolution::Solve(const double p0_, const bool estimate_p0) {
+    int n = ts.size(), m = nodes.size();
+    int nreg = max(m - 2, 0);
+    int nx = m + (estimate_p0 ? 1 : 0);
+    Eigen::Map<const Eigen::VectorXd> pm(ps.data(), n);
+    p0 = p0_;
+    // misfit is normalized by the rms pressure change, curvature by the number of its terms
+    double scale = estimate_p0 ? sqrt((pm.array() - pm.mean()).square().mean()) : sqrt((p0 - pm.array()).square().mean());
+    if (scale == 0.) scale = 1.;
+    double wd = 1./(sqrt(static_cast<double>(n))*scale);
+    double wr = nreg > 0 ? sqrt(reg/nreg) : 0.;
+    // initial guess: constant z fitted to the pressure change
+    Eigen::VectorXd c = basis*Eigen::VectorXd::Constant(m, h);
+    double amp = c.dot((p0 - pm.array()).matrix())/max(c.squaredNorm(), numeric_limits<double>::min());
+    z = Eigen::VectorXd::Constant(m, log(amp > 0. ? amp : 1.));
+
+    auto residuals = [&](const Eigen::VectorXd& zz, const double pp0, Eigen::VectorXd& res, Eigen::MatrixXd* jac) {
+        Eigen::VectorXd a = h*zz.array().exp().matrix();
+        res.resize(n + nreg);
+        res.head(n) = wd*((pp0 - (basis*a).array()).matrix() - pm);
+        for (int j = 0; j < nreg; ++j)
+            res[n+j] = wr*(zz[j] - 2.*zz[j+1] + zz[j+2]);
+        if (!jac) return;
+        jac->setZero(n + nreg, nx);
+        jac->topLeftCorner(n, m) = -wd*(basis*a.asDiagonal());
+        if (estimate_p0) jac->col(m).head(n).setConstant(wd);
+        for (int j = 0; j < nreg; ++j) {
+            (*jac)(n+j, j) = wr;
+            (*jac)(n+j, j+1) = -2.*wr;
+            (*jac)(n+j, j+2) = wr;
+        }
+    };
+
+    DeconvReport report;
+    report.converged = false;
+    report.iterations = 0;
+    report.message = "max number of iterations reached";
+    Eigen::VectorXd res, trial_res;
+    Eigen::MatrixXd jac;
+    residuals(z, p0, res, &jac);
+    double cost = 0.5*res.squaredNorm();
+    double lambda = 1e-3;
+    while (report.iterations < DECONV_MAXIT && !report.converged) {
+        ++report.iterations;
+        Eigen::MatrixXd jtj = jac.transpose()*jac;
+        Eigen::VectorXd jtr = jac.transpose()*res;
+        while (true) {
+            Eigen::MatrixXd a = jtj;
+            a.diagonal() += lambda*jtj.diagonal().cwiseMax(numeric_limits<double>::min());
+            Eigen::VectorXd step = a.ldlt().solve(-jtr);
+            Eigen::VectorXd zt = z + step.head(m);
+            double p0t = estimate_p0 ? p0 + step[m] : p0;
+            residuals(zt, p0t, trial_res, nullptr);
+            double trial_cost = 0.5*trial_res.squaredNorm();
+            if (trial_cost < cost) {
+                double reduction = (cost - trial_cost)/cost;
+                z = zt;
+                p0 = p0t;
+                cost = trial_cost;
+                residuals(z, p0, res, &jac);
+                lambda = max(lambda/10., 1e-12);
+                if (reduction < DECONV_TOL) {
+                    report.converged = true;
+                    report.message = "relative cost reduction is below tolerance";
+                }
+                break;
+            }
+            lambda *= 10.;
+            if (lambda > 1e10) {
+                report.converged = true;
+                report.message = "no descent direction, damping parameter limit reached";
+                break;
+            }
+        }
+    }
+    report.p0 = p0;
+    report.rms = res.head(n).norm()/wd/sqrt(static_cast<double>(n));
+    report.curvature = nreg > 0 ? res.tail(nreg).norm()/wr/sqrt(static_cast<double>(nreg)) : 0.;
+    return report;
+}
+
+void Deconvolution::Response(const std::vector<double>& taus, std::vector<double>& pu, std::vector<double>& dpu) const {
+    pu.assign(taus.size(), 0.);
+    dpu.assign(taus.size(), 0.);
+    for (size_t i = 0; i < taus.size(); ++i) {
+        for (size_t j = 0; j < nodes.size(); ++j) {
+            double a = h*exp(z[j]);
+            double x = taus[i]/nodes[j];
+            pu[i] -= a*expm1(-x);
+            dpu[i] += a*x*exp(-x);
+        }
+    }
+}
+
+std::vector<double> Deconvolution::Model() const {
+    Eigen::VectorXd a = h*z.array().exp().matrix();
+    Eigen::VectorXd p = (p0 - (basis*a).array()).matrix();
+    return vector<double>(p.data(), p.data() + p.size());
+}
+
+const std::vector<double>& Deconvolution::Nodes() const {
+    return nodes;
+}
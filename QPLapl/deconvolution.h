@@ -0,0 +1,55 @@
+#ifndef DECONVOLUTION_H
+#define DECONVOLUTION_H
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
+#include <Eigen/Dense>
+
+static const int DECONV_NODES_PER_DECADE = 5;
+static const double DECONV_REG = 1e-4; // weight of the curvature of z relative to the normalized misfit
+static const int DECONV_MAXIT = 500;
+static const double DECONV_TOL = 1e-10; // relative cost reduction that stops iterations
+
+struct DeconvReport {
+    double p0; // initial pressure, estimated or given
+    double rms; // rms of pressure residuals
+    double curvature; // rms of the second differences of z
+    int iterations;
+    bool converged;
+    std::string message;
+    std::string ToString() const;
+};
+
+class Deconvolution {
+    // Unit rate drawdown response from a measured pressure series and a piecewise constant rate history
+    // (qs[k] acts on (ts_rate[k-1], ts_rate[k]], the first one from 0), after von Schroeter et al.:
+    // the unknowns are z = ln(dp_u/dln(t)) at log-spaced lags tau_m, fitted by regularized Gauss-Newton
+    // least squares with the curvature of z as the regularization term.
+    // The response derivative is a sum of bumps on the log axis, dp_u/dln(t) = sum h*exp(z_m)*(t/tau_m)*exp(-t/tau_m),
+    // so p_u(t) = sum h*exp(z_m)*(1 - exp(-t/tau_m)) and the convolution with the rate history is linear
+    // in exp(z). Its basis is calculated once by a recursion over time, O((N_t + N_q)*N_nodes),
+    // and every iteration is a single (N_t x N_nodes) product.
+public:
+    Deconvolution(const std::vector<double>& ts, const std::vector<double>& ps,
+            const std::vector<double>& ts_rate, const std::vector<double>& qs,
+            const double reg = DECONV_REG);
+    DeconvReport Solve(const double p0, const bool estimate_p0 = false);
+    void Response(const std::vector<double>& taus, std::vector<double>& pu, std::vector<double>& dpu) const; // p_u and dp_u/dln(t)
+    std::vector<double> Model() const; // pressures at ts reproduced by the current response
+    const std::vector<double>& Nodes() const;
+private:
+    const std::vector<double> ts, ps;
+    const double reg;
+    std::vector<double> nodes; // tau_m
+    double h; // node spacing in ln(t)
+    Eigen::MatrixXd basis; // basis(i, m) = sum over rate steps before ts[i] of dq*(1 - exp(-(ts[i]-tau_k)/tau_m))
+    Eigen::VectorXd z;
+    double p0;
+    void MakeBasis(const std::vector<double>& ts_rate, const std::vector<double>& qs);
+};
+
+#endif // DECONVOLUTION_H
@@ -1,12 +1,91 @@
 #include "gwell.h"
+#include "interp_1d.h"
 
 using namespace std;
 
-LaplWell::LaplWell(): stehf_coefs(CalcStehf(NCOEF)) {};
+LaplWell::LaplWell(): stehf_coefs(CalcStehf(NCOEF)), lowrank_tol(0.), treecode_tol(0.), asympt_tol(0.), asympt_ready(false),
+        td_early(0.), td_late(numeric_limits<double>::infinity()) {};
 LaplWell::~LaplWell() {};
 double LaplWell::pwd(const double td) const {
+    PROFILE_SCOPE(ProfKernel::Pwd);
+    const Asymptote* regime = Regime(td);
+    if (regime) PROFILE_COUNT(ProfKernel::Pwd, hits, 1);
+    return regime ? regime->pwd(td) : pwd_full(td);
+}
+
+double LaplWell::pwd_full(const double td) const {
     return InverseLaplace(pwd_lapl, td);
 }
+
+Asymptotes LaplWell::asymptotes() const {
+    return Asymptotes();
+}
+
+void LaplWell::SetAsymptoteTolerance(const double tol) {
+    lock_guard<mutex> lock(asympt_mutex);
+    asympt_tol = tol;
+    asympt_ready = false;
+}
+
+void LaplWell::SetLowRankTolerance(const double tol) {
+    lowrank_tol = tol;
+}
+
+void LaplWell::SetTreecodeTolerance(const double tol) {
+    treecode_tol = tol;
+}
+
+const Asymptote* LaplWell::Regime(const double td) const {
+    lock_guard<mutex> lock(asympt_mutex);
+    if (asympt_tol <= 0.) return nullptr;
+    if (!asympt_ready) {
+        asympt = asymptotes();
+        auto agrees = [this](const Asymptote& a, const double t) {
+            double p = pwd_full(t);
+            return abs(a.pwd(t) - p) <= asympt_tol*abs(p);
+        };
+        // from the start of the search towards the regime, two successive agreements fix the crossover
+        auto search = [&agrees](const Asymptote& a, const double mult, double& td_cross) {
+            if (!a.pwd) return;
+            bool prev = false;
+            double t = a.td;
+            for (int k = 0; k < ASYMPT_STEPS; ++k, t *= mult) {
+                bool cur = agrees(a, t);
+                if (cur && prev) {
+                    td_cross = t;
+                    return;
+                }
+                prev = cur;
+            }
+        };
+        td_early = 0.;
+        td_late = numeric_limits<double>::infinity();
+        search(asympt.early, 0.5, td_early);
+        search(asympt.late, 2., td_late);
+        asympt_ready = true;
+    }
+    if (td <= td_early) return &asympt.early;
+    if (td >= td_late) return &asympt.late;
+    return nullptr;
+}
+
+double LaplWell::LateConstant(const double slope, const double u) const {
+    // u*pwd_lapl(u) = slope/u + b + O(u), Richardson extrapolation over u and u/2
+    auto f = [this, slope](const double s) {return s*pwd_lapl(s) - slope/s;};
+    return 2.*f(0.5*u) - f(u);
+}
+
+Asymptote LaplWell::Bounded(const Boundary boundary, const double area, const double td) const {
+    // pwd = 2*pi*td/area + b in a closed area, pwd = b with constant pressure boundaries;
+    // the transients decay as exp(-td/td0) with td0 ~ td, so b is extrapolated from u = 1e-3/td
+    Asymptote ans;
+    double slope = boundary == Boundary::CCCC ? 0. : 2.*FastBessel::PI/area;
+    double b = LateConstant(slope, 1e-3/td);
+    ans.pwd = [slope, b](const double t) {return slope*t + b;};
+    ans.dpwd = [slope](const double t) {return slope*t;};
+    ans.td = td;
+    return ans;
+}
 void LaplWell::pwd_parallel(const std::vector<double>& tds, std::vector<double>& pwds, int nthreads) const {
     InverseLaplaceParallel(pwd, tds, pwds, nthreads);
 }
@@ -23,20 +102,240 @@ double LaplWell::pd(const double td, const double xd, const double yd, const dou
     return InverseLaplaceXYZ(pd_lapl, td, xd, yd, zd);
 }
 
+void LaplWell::pwd_and_derivative(const std::vector<double>& tds, std::vector<double>& pwds, std::vector<double>& dpwds,
+        int nthreads) const {
+    // pwd(0) = 0, so dpwd/dtd is the inverse of u*pwd_lapl(u)
+    pwds.resize(tds.size());
+    dpwds.resize(tds.size());
+    vector<size_t> index(tds.size());
+    for (size_t j = 0; j < index.size(); ++j) index[j] = j;
+    auto pages = NPaginate(index, nthreads);
+    vector<future<void>> futures;
+    for (auto& page: pages) {
+        futures.push_back(async(launch::async, [this, &tds, &pwds, &dpwds](auto pg) {
+            for (size_t j: pg) {
+                if (const Asymptote* regime = this->Regime(tds[j])) {
+                    PROFILE_COUNT(ProfKernel::Pwd, hits, 1);
+                    pwds[j] = regime->pwd(tds[j]);
+                    dpwds[j] = regime->dpwd(tds[j]);
+                    continue;
+                }
+                PROFILE_SCOPE(ProfKernel::InverseLaplace);
+                PROFILE_COUNT(ProfKernel::InverseLaplace, evals, NCOEF);
+                double s_mult = std::log(2.)/tds[j];
+                double p = 0., dp = 0.;
+                for (int i = 1; i <= NCOEF; ++i) {
+                    double s = i*s_mult;
+                    double v = this->pwd_lapl(s)*s*stehf_coefs[i]/i;
+                    p += v;
+                    dp += v*s;
+                }
+                pwds[j] = p;
+                dpwds[j] = dp*tds[j];
+            }
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
+}
+
+void LaplWell::pwd_schedule(const std::vector<double>& tds, const std::vector<double>& tds_rate, const std::vector<double>& qds,
+        std::vector<double>& pwds, int nthreads, const RateInterp interp) const {
+    // Superposition of unit rate responses: a rate step dq at tau adds dq*pwd(t-tau), a slope change dm
+    // adds dm*P1(t-tau) with P1 = L^-1{pwd_lapl/u}. The product of pwd_lapl and the transform of the whole
+    // rate history can not be inverted by Stehfest across rate changes, so both responses are inverted once
+    // on a log grid of lags (or at the lags themselves if there are less of them) and interpolated.
+    if (tds_rate.empty() || tds_rate.size() != qds.size())
+        throw invalid_argument("LaplWell::pwd_schedule: rate schedule is empty or of different size\n");
+    for (size_t k = 1; k < tds_rate.size(); ++k)
+        if (tds_rate[k] <= tds_rate[k-1])
+            throw invalid_argument("LaplWell::pwd_schedule: rate schedule times must increase\n");
+    vector<pair<double, double>> steps, ramps;
+    if (interp == RateInterp::Step) {
+        for (size_t k = 0; k < qds.size(); ++k)
+            steps.push_back({k == 0 ? 0. : tds_rate[k-1], k == 0 ? qds[0] : qds[k] - qds[k-1]});
+    } else {
+        steps.push_back({0., qds[0]});
+        double m_prev = 0.;
+        for (size_t k = 0; k + 1 < qds.size(); ++k) {
+            double m = (qds[k+1] - qds[k])/(tds_rate[k+1] - tds_rate[k]);
+            ramps.push_back({tds_rate[k], m - m_prev});
+            m_prev = m;
+        }
+        ramps.push_back({tds_rate.back(), -m_prev});
+    }
+    vector<double> lags;
+    for (double t: tds) {
+        for (const auto& s: steps)
+            if (t > s.first && s.second != 0.) lags.push_back(t - s.first);
+        for (const auto& r: ramps)
+            if (t > r.first && r.second != 0.) lags.push_back(t - r.first);
+    }
+    sort(lags.begin(), lags.end());
+    lags.erase(unique(lags.begin(), lags.end()), lags.end());
+    pwds.assign(tds.size(), 0.);
+    if (lags.empty()) return;
+    vector<double> nodes = lags;
+    size_t ngrid = static_cast<size_t>(ceil(log10(lags.back()/lags.front())*SCHED_PTS_PER_DECADE)) + 1;
+    if (ngrid >= 4 && ngrid < lags.size()) {
+        nodes.resize(ngrid);
+        for (size_t j = 0; j < ngrid; ++j)
+            nodes[j] = lags.front()*pow(lags.back()/lags.front(), static_cast<double>(j)/(ngrid - 1));
+        nodes.back() = lags.back();
+    }
+    vector<double> pstep(nodes.size()), pramp(nodes.size());
+    StepRampResponse(nodes, pstep, pramp, nthreads);
+    if (nodes.size() == 1) {
+        for (size_t i = 0; i < tds.size(); ++i) {
+            for (const auto& s: steps)
+                if (tds[i] > s.first) pwds[i] += s.second*pstep[0];
+            for (const auto& r: ramps)
+                if (tds[i] > r.first) pwds[i] += r.second*pramp[0];
+        }
+        return;
+    }
+    // P1 grows as lag*pwd, P1/lag is interpolated to keep the same accuracy as for pwd
+    vector<double> lnodes(nodes.size());
+    for (size_t j = 0; j < nodes.size(); ++j) {
+        lnodes[j] = log(nodes[j]);
+        pramp[j] /= nodes[j];
+    }
+    int m = min<int>(4, nodes.size());
+    Poly_interp step_interp(lnodes, pstep, m), ramp_interp(lnodes, pramp, m);
+    for (size_t i = 0; i < tds.size(); ++i) {
+        for (const auto& s: steps)
+            if (tds[i] > s.first && s.second != 0.) pwds[i] += s.second*step_interp.interp(log(tds[i] - s.first));
+        for (const auto& r: ramps)
+            if (tds[i] > r.first && r.second != 0.) pwds[i] += r.second*(tds[i] - r.first)*ramp_interp.interp(log(tds[i] - r.first));
+    }
+}
+
+void LaplWell::StepRampResponse(const std::vector<double>& lags, std::vector<double>& steps, std::vector<double>& ramps, int nthreads) const {
+    vector<size_t> index(lags.size());
+    for (size_t j = 0; j < index.size(); ++j) index[j] = j;
+    auto pages = NPaginate(index, nthreads);
+    vector<future<void>> futures;
+    for (auto& page: pages) {
+        futures.push_back(async(launch::async, [this, &lags, &steps, &ramps](auto pg) {
+            for (size_t j: pg) {
+                double s_mult = std::log(2.)/lags[j];
+                double step = 0., ramp = 0.;
+                for (int i = 1; i <= NCOEF; ++i) {
+                    double s = i*s_mult;
+                    double v = this->pwd_lapl(s)*stehf_coefs[i]/i;
+                    step += v*s;
+                    ramp += v;
+                }
+                steps[j] = step;
+                ramps[j] = ramp;
+            }
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
+}
+
 Matrix3DV LaplWell::pd_m_parallel(const double td, int nthreads, const std::vector<double>& xs,
             const std::vector<double>& ys,
             const std::vector<double>& zs) const {
     Matrix3DV grid = MakeGrid(xs, ys, zs);
+    pd_m_parallel(td, nthreads, grid);
+    return grid;
+}
+
+GridSymmetry LaplWell::symmetry() const {
+    return {};
+}
+
+double LaplWell::pwd_lapl_grad(const double, Eigen::VectorXd&) const {
+    throw std::logic_error("parameter sensitivities are not implemented for this well\n");
+}
+
+double LaplWell::pwd_grad(const double td, Eigen::VectorXd& grad) const {
+    double s_mult = std::log(2.)/td;
+    double ans = 0.;
+    Eigen::VectorXd g;
+    for (int i = 1; i <= NCOEF; ++i) {
+        double s = i*s_mult;
+        double mult = s*stehf_coefs[i]/i;
+        ans += pwd_lapl_grad(s, g)*mult;
+        if (i == 1)
+            grad = g*mult;
+        else
+            grad += g*mult;
+    }
+    return ans;
+}
+
+void LaplWell::pd_m_parallel(const double td, int nthreads, Matrix3DV& grid, const bool use_symmetry) const {
+    GridSymmetry sym = symmetry();
+    if (use_symmetry && (sym.x || sym.y)) {
+        vector<size_t> index;
+        Matrix3DV fund = FoldGrid(grid, sym, index);
+        if (fund.size() < grid.size()) {
+            pd_m_direct(td, nthreads, fund);
+            size_t i = 0;
+            for (auto& p: grid)
+                p.val = fund(index[i++], 0).val;
+            return;
+        }
+    }
+    pd_m_direct(td, nthreads, grid);
+}
+
+Matrix3DV LaplWell::FoldGrid(Matrix3DV& grid, const GridSymmetry& sym, std::vector<size_t>& index) const {
+    map<tuple<long long, long long, double>, size_t> unique_pts;
+    vector<PointXYZV> pts;
+    index.clear();
+    index.reserve(grid.size());
+    for (const auto& p: grid) {
+        double x = sym.x ? sym.x0 + abs(p.x - sym.x0) : p.x;
+        double y = sym.y ? sym.y0 + abs(p.y - sym.y0) : p.y;
+        auto key = make_tuple(llround(x/SYM_EPS), llround(y/SYM_EPS), p.z);
+        auto it = unique_pts.find(key);
+        if (it == unique_pts.end()) {
+            it = unique_pts.insert({key, pts.size()}).first;
+            pts.push_back({x, y, p.z});
+        }
+        index.push_back(it->second);
+    }
+    Matrix3DV ans(pts.size(), 1, 1);
+    for (size_t i = 0; i < pts.size(); ++i)
+        ans(i, 0) = pts[i];
+    return ans;
+}
+
+void LaplWell::pd_m_direct(const double td, int nthreads, Matrix3DV& grid) const {
+    TRACE_SCOPE("pd_m_direct", "td", td);
+    for (auto& p: grid)
+        p.val = 0.;
     Matrix3DV aux = grid;
     double s_mult = std::log(2.)/td;
     for (int i = 1; i <= NCOEF; ++i) {
         double s = i*s_mult;
         {
+            TRACE_SCOPE("Stehfest node", "u", s);
             pd_lapl_m(s, grid, aux, nthreads);
+            TRACE_SCOPE("MultVals/AddVals", "points", grid.size());
             aux.MultVals(s*stehf_coefs[i]/i);
             grid.AddVals(aux);
         }
     }
+}
+
+Matrix3DV LaplWell::pd_m_adaptive(const double td, int nthreads, const std::vector<double>& xs,
+            const std::vector<double>& ys,
+            const std::vector<double>& zs,
+            const double tol) const {
+    Matrix3DV grid = MakeGrid(xs, ys, zs);
+    for (size_t k = 0; k < zs.size(); ++k) {
+        AdaptiveGrid2D agrid(xs, ys, zs[k], tol);
+        agrid.Refine([this, td, nthreads](Matrix3DV& batch) {
+            TRACE_SCOPE("adaptive batch", "points", batch.size());
+            this->pd_m_parallel(td, nthreads, batch);
+        });
+        agrid.Resample(grid, k);
+    }
     return grid;
 }
 
@@ -46,6 +345,7 @@ Matrix3DV LaplWell::pd_lapl_m(const double u, const Matrix3DV& grid, int nthread
     vector<future<void>> futures;
     for (auto& page: pages) {
         futures.push_back(async([this, u](auto pg){
+            TRACE_SCOPE("grid page", "points", pg.size());
             for (auto& p: pg) {
                 p.val = this->pd_lapl(u, p.x, p.y, p.z);
             };
@@ -60,6 +360,7 @@ void LaplWell::pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& ans,
     vector<future<void>> futures;
     for (auto& page: pages) {
         futures.push_back(async([this, u](auto pg){
+            TRACE_SCOPE("grid page", "points", pg.size());
             for (auto& p: pg) {
                 p.val = this->pd_lapl(u, p.x, p.y, p.z);
             };
@@ -67,90 +368,268 @@ void LaplWell::pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& ans,
     }
 }
 
+SkinWell::SkinWell(std::unique_ptr<LaplWell> well, const double skin): well(std::move(well)), skin(skin) {};
+
+double SkinWell::pd_lapl(const double u, const double xd, const double yd, const double zd) const {
+    return well->pd_lapl(u, xd, yd, zd);
+}
+
+void SkinWell::pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const {
+    well->pd_lapl_m(u, grid, buf, nthread);
+}
+
+double SkinWell::pwd_lapl(const double u) const {
+    return well->pwd_lapl(u) + skin/u;
+}
+
+double SkinWell::qwd_lapl(const double u) const {
+    return 1./(u*u*pwd_lapl(u));
+}
+
+Asymptotes SkinWell::asymptotes() const {
+    Asymptotes ans = well->asymptotes();
+    const double s = skin;
+    for (Asymptote* a: {&ans.early, &ans.late}) {
+        if (!a->pwd) continue;
+        auto pwd = a->pwd;
+        a->pwd = [pwd, s](const double td) {return pwd(td) + s;};
+    }
+    return ans;
+}
+
+GridSymmetry SkinWell::symmetry() const {
+    return well->symmetry();
+}
+
+SurrogateWell::SurrogateWell(std::unique_ptr<LaplWell> well, const double td_min, const double td_max,
+        const int nthreads, const double eps): well(std::move(well)),
+        lumin(std::log(std::log(2.)/td_max)), lumax(std::log(NCOEF*std::log(2.)/td_min)),
+        samples(0), error(numeric_limits<double>::infinity()) {
+    if (!(td_min > 0.) || !(td_max > td_min))
+        throw invalid_argument("SurrogateWell: td range must be positive and increasing\n");
+    Fit(nthreads, eps);
+}
+
+double SurrogateWell::pd_lapl(const double u, const double xd, const double yd, const double zd) const {
+    return well->pd_lapl(u, xd, yd, zd);
+}
+
+void SurrogateWell::pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const {
+    well->pd_lapl_m(u, grid, buf, nthread);
+}
+
+double SurrogateWell::pwd_lapl(const double u) const {
+    double lu = std::log(u);
+    if (coefs.empty() || lu < lumin || lu > lumax) return well->pwd_lapl(u);
+    return exp(Series(coefs, (2.*lu - lumin - lumax)/(lumax - lumin)))/u;
+}
+
+double SurrogateWell::qwd_lapl(const double u) const {
+    return 1./(u*u*pwd_lapl(u));
+}
+
+GridSymmetry SurrogateWell::symmetry() const {
+    return well->symmetry();
+}
+
+Asymptotes SurrogateWell::asymptotes() const {
+    return well->asymptotes();
+}
+
+int SurrogateWell::Samples() const {
+    return samples;
+}
+
+double SurrogateWell::ErrorEstimate() const {
+    return error;
+}
+
+void SurrogateWell::Fit(const int nthreads, const double eps) {
+    // f_j = log(u*pwd_lapl(u)) at t_j = cos(pi*j/n); doubling n keeps the old nodes as the even ones
+    vector<double> f;
+    auto sample = [this, nthreads](const int n, const int first, const int step, vector<double>& vals) {
+        vector<int> index;
+        for (int j = first; j <= n; j += step) index.push_back(j);
+        vector<future<void>> futures;
+        for (auto& page: NPaginate(index, nthreads)) {
+            futures.push_back(async(launch::async, [this, n, &vals](auto pg) {
+                for (int j: pg) {
+                    double lu = 0.5*(lumin + lumax) + 0.5*(lumax - lumin)*cos(Rectangular::PI*j/n);
+                    double u = exp(lu);
+                    double p = this->well->pwd_lapl(u);
+                    vals[j] = p > 0. ? std::log(u*p) : numeric_limits<double>::quiet_NaN();
+                }
+            }, page));
+        }
+        for (auto& fut: futures)
+            fut.get();
+        samples += index.size();
+    };
+    auto interpolate = [](const vector<double>& vals) {
+        // coefficients of the interpolant on the Chebyshev-Lobatto nodes, a discrete cosine transform
+        const int n = vals.size() - 1;
+        vector<double> c(n + 1);
+        for (int k = 0; k <= n; ++k) {
+            double sum = 0.5*(vals[0] + (k%2 ? -vals[n] : vals[n]));
+            for (int j = 1; j < n; ++j)
+                sum += vals[j]*cos(Rectangular::PI*j*k/n);
+            c[k] = 2.*sum/n;
+        }
+        c[0] *= 0.5;
+        c[n] *= 0.5;
+        return c;
+    };
+    int n = SURR_MIN_DEG;
+    f.assign(n + 1, 0.);
+    sample(n, 0, 1, f);
+    while (true) {
+        for (double v: f)
+            if (!isfinite(v)) return;
+        vector<double> c = interpolate(f);
+        if (2*n > SURR_MAX_DEG) return;
+        vector<double> f2(2*n + 1);
+        for (int j = 0; j <= n; ++j)
+            f2[2*j] = f[j];
+        sample(2*n, 1, 2, f2);
+        double err = 0.;
+        for (int j = 1; j < 2*n; j += 2)
+            err = max(err, abs(Series(c, cos(Rectangular::PI*j/(2*n))) - f2[j])); // log difference is the relative one
+        n *= 2;
+        f.swap(f2);
+        if (err < eps) {
+            for (double v: f)
+                if (!isfinite(v)) return;
+            coefs = interpolate(f);
+            error = err;
+            return;
+        }
+    }
+}
+
+double SurrogateWell::Series(const std::vector<double>& c, const double t) const {
+    double b1 = 0., b2 = 0.;
+    for (int k = c.size() - 1; k >= 1; --k) {
+        double b = 2.*t*b1 - b2 + c[k];
+        b2 = b1;
+        b1 = b;
+    }
+    return t*b1 - b2 + c[0];
+}
+
 namespace Rectangular {
-Well::Well(): LaplWell(), bess(false), dx(1./NSEG) {};
+Well::Well(): LaplWell(), bess(FastBessel::Bess::Shared()), dx(1./NSEG) {};
 Well::~Well() {};
 
-double Well::SEXP(const double y, const double e) const {
-    double b = exp(-2.*y*e);
+double ScalarValue(const double x) {
+    return x;
+}
+
+double ScalarValue(const DualD& x) {
+    return x.value();
+}
+
+template <typename S>
+S Well::SEXP(const S& y, const S& e) const {
+    S b = exp(-2.*y*e);
     return b/(1.-b);
 };
 
+template <Boundary B, typename S>
 void Well::fill_if1(const double u,
-        const double ywd, const double yed,
+        const double ywd, const S& yed,
         const double alpha,
-        Eigen::MatrixXd& matrix) const {
+        MatrixS<S>& matrix) const {
+    if (!Images<B>::mean) {
+        matrix = MatrixS<S>::Zero(2*NSEG, 2*NSEG);
+        return;
+    }
     double squ = sqrt(u+alpha*alpha);
-    double ans = 0.5*dx/squ;
+    S ans = 0.5*dx/squ;
     double dy = std::abs(ywd-ywd);
     double sumy = ywd+ywd;
     ans *= exp(-squ*(2.*yed-sumy))+exp(-squ*sumy)+exp(-squ*(2.*yed-dy))+exp(-squ*dy);
-    ans *= (1+SEXP(yed, squ));
-    matrix = Eigen::MatrixXd::Ones(2*NSEG, 2*NSEG)*ans;
+    ans *= (1+SEXP<S>(yed, squ));
+    matrix = MatrixS<S>::Constant(2*NSEG, 2*NSEG, ans);
 }
 
+template <Boundary B>
 void Well::vect_if1_yd(const double u,
         const double yd, const double ywd, const double yed,
         const double alpha,
         Eigen::VectorXd& buf) const {
+    buf = Eigen::VectorXd::Ones(2*NSEG)*(dx*pnt_if1_yd<B>(u, yd, ywd, yed, alpha));
+}
+
+template <Boundary B>
+double Well::pnt_if1_yd(const double u,
+        const double yd, const double ywd, const double yed,
+        const double alpha) const {
+    if (!Images<B>::mean) return 0.;
     double squ = sqrt(u+alpha*alpha);
-    double ans = 0.5*dx/squ;
+    double ans = 0.5/squ;
     double dy = std::abs(yd-ywd);
     double sumy = yd+ywd;
     ans *= exp(-squ*(2.*yed-sumy))+exp(-squ*sumy)+exp(-squ*(2.*yed-dy))+exp(-squ*dy);
     ans *= (1+SEXP(yed, squ));
-    buf = Eigen::VectorXd::Ones(2*NSEG)*ans;
+    return ans;
 }
 
+template <Boundary B, typename S>
 void Well::fill_if2e(const double u,
         const double xwd,
-        const double xed, const double xede,
-        const double ywd, const double yed,
+        const S& xed, const S& xede,
+        const double ywd, const S& yed,
         const double alpha,
-        Eigen::MatrixXd& matrix, Eigen::VectorXd& buf) const {
-    matrix = Eigen::MatrixXd::Zero(2*NSEG, 2*NSEG);
-    const double term1 = PI/xed*(2*yed-(ywd+ywd));
-    const double term2 = PI/xed*(2*yed-abs(ywd-ywd));
-    const double term3 = PI/xed*(ywd+ywd);
-    const double term4 = PI/xed*(2*yed+abs(ywd-ywd));
+        MatrixS<S>& matrix, VectorS<S>& buf) const {
+    matrix = MatrixS<S>::Zero(2*NSEG, 2*NSEG);
+    const double xed_ = ScalarValue(xed), yed_ = ScalarValue(yed);
+    const double term1 = PI/xed_*(2*yed_-(ywd+ywd));
+    const double term2 = PI/xed_*(2*yed_-abs(ywd-ywd));
+    const double term3 = PI/xed_*(ywd+ywd);
+    const double term4 = PI/xed_*(2*yed_+abs(ywd-ywd));
     const double dterm1 = 1.-exp(-term1);
     const double dterm2 = 1.-exp(-term2);
     const double dterm3 = 1.-exp(-term3);
     const double dterm4 = 1.-exp(-term4);
-    double ek_term, ek_, sexp_, aydywd, kpiOxed, ydPywd, mmult, A, d, max_mat=0.;
+    S ek_term, ek_, sexp_, kpiOxed, mmult;
+    double aydywd, ydPywd, A, d, max_mat=0.;
+    PROFILE_SCOPE(ProfKernel::FillIf2e);
     for (int k = 1; k <= KMAX; ++k) {
+        PROFILE_COUNT(ProfKernel::FillIf2e, terms, 1);
         ek_term = k*PI/xede;
         ek_ = sqrt(u + ek_term*ek_term + alpha*alpha);
-        sexp_ = SEXP(yed, ek_);
+        sexp_ = SEXP<S>(yed, ek_);
         aydywd = abs(ywd-ywd); //!
         kpiOxed = k*PI/xed;
         ydPywd = ywd + ywd; //!
-        mmult = 2./kpiOxed/ek_*((std::exp(-ek_*(2.*yed - ydPywd)) + std::exp(-ek_*ydPywd) + std::exp(-ek_*(2.*yed-aydywd)))*(1 + sexp_)
-                + std::exp(-ek_*aydywd)*sexp_);
+        mmult = 2./kpiOxed/ek_*((Images<B>::mirror*(exp(-ek_*(2.*yed - ydPywd)) + exp(-ek_*ydPywd)) + exp(-ek_*(2.*yed-aydywd)))*(1 + sexp_)
+                + exp(-ek_*aydywd)*sexp_);
         for (int j = 0; j < 2*NSEG; ++j) {
             double x1 = -1.+j*dx;
             double x2 = x1 + dx;
-            buf(j)  = mmult*sin(0.5*kpiOxed*(x2 - x1))*std::cos(0.5*kpiOxed*(2.*xwd + x1 + x2));
-            if (abs(buf(j)) > max_mat) max_mat = abs(buf(j));
+            buf(j)  = mmult*sin(0.5*kpiOxed*(x2 - x1))*Images<B>::mode(0.5*kpiOxed*(2.*xwd + x1 + x2));
+            if (abs(ScalarValue(buf(j))) > max_mat) max_mat = abs(ScalarValue(buf(j)));
         }
         for (int i = 0; i < 2*NSEG; ++i) {
             double xd = (xwd-1.+(i+0.5)*dx);
-            double row_mult = cos(kpiOxed*xd);
+            S row_mult = Images<B>::mode(kpiOxed*xd);
             for (int j = 0; j < 2*NSEG; ++j) {
                 matrix(i,j) += row_mult*buf(j);
             }
         }
-        A = 2*xed/PI/(1-exp(-2*ek_*yed));
+        A = 2*xed_/PI/(1-exp(-2*ScalarValue(ek_)*yed_));
         d = A*(exp(-k*term1)/dterm1+exp(-k*term2)/dterm2+exp(-k*term3)/dterm3 + exp(-k*term4)/dterm4);
         if (isnan(d)) d = 0.;
         if (k > KMIN && (abs(d) <= TINY || abs(max_mat) <= TINY || abs(d/max_mat) < SUM_EPS)) break;
     }
 }
 
+template <Boundary B>
 void Well::vect_if2e_yd(const double u, const double xd, const double xwd,
         const double xed, const double xede,
         const double yd, const double ywd, const double yed,
-        const double alpha, Eigen::VectorXd& buf) const {
+        const double alpha, Eigen::VectorXd& buf,
+        const int jbegin, const int jend) const {
     buf = Eigen::VectorXd::Zero(2*NSEG);
     const double term1 = PI/xed*(2*yed-(yd+ywd));
     const double term2 = PI/xed*(2*yed-abs(yd-ywd));
@@ -168,13 +647,13 @@ void Well::vect_if2e_yd(const double u, const double xd, const double xwd,
         aydywd = abs(yd-ywd); //!
         kpiOxed = k*PI/xed;
         ydPywd = yd + ywd; //!
-        mmult =  2./kpiOxed/ek_*((std::exp(-ek_*(2.*yed - ydPywd)) + std::exp(-ek_*ydPywd) + std::exp(-ek_*(2.*yed-aydywd)))*(1 + sexp_)
+        mmult =  2./kpiOxed/ek_*((Images<B>::mirror*(std::exp(-ek_*(2.*yed - ydPywd)) + std::exp(-ek_*ydPywd)) + std::exp(-ek_*(2.*yed-aydywd)))*(1 + sexp_)
                 + std::exp(-ek_*aydywd)*sexp_);
-        row_mult = cos(kpiOxed*xd);
-        for (int j = 0; j < 2*NSEG; ++j) {
+        row_mult = Images<B>::mode(kpiOxed*xd);
+        for (int j = jbegin; j < jend; ++j) {
             double x1 = -1.+j*dx;
             double x2 = x1 + dx;
-            buf(j)  += row_mult*mmult*sin(0.5*kpiOxed*(x2 - x1))*std::cos(0.5*kpiOxed*(2.*xwd + x1 + x2));
+            buf(j)  += row_mult*mmult*sin(0.5*kpiOxed*(x2 - x1))*Images<B>::mode(0.5*kpiOxed*(2.*xwd + x1 + x2));
             if (abs(buf(j)) > max_mat) max_mat = abs(buf(j));
         }
         A = 2*xed/PI/(1-exp(-2*ek_*yed));
@@ -184,113 +663,214 @@ void Well::vect_if2e_yd(const double u, const double xd, const double xwd,
     }
 }
 
-void Well::fill_i1f2h(const double u,
-        const double xwd, const double xed, const double xede, const double alpha,
-        Eigen::MatrixXd& matrix, Eigen::VectorXd& buf) const {
-    for (int i: {0, 2*NSEG-1}) {
-        double xd = xwd-1.+(i+0.5)*dx;
-        vect_i1f2h(u, xd, xwd, xed, xede, alpha, buf);
-        for (int j = 0; j < 2*NSEG; ++j)
-            matrix(i,j) = buf(j);
+template <Boundary B>
+double Well::pnt_if2e_yd(const double u, const double xd, const double xwd,
+        const double xed, const double xede,
+        const double yd, const double ywd, const double yed,
+        const double alpha) const {
+    // vect_if2e_yd of a segment dx around xwd divided by dx as dx -> 0:
+    // sin(0.5*kpiOxed*dx)/dx -> 0.5*kpiOxed
+    const double term1 = PI/xed*(2*yed-(yd+ywd));
+    const double term2 = PI/xed*(2*yed-abs(yd-ywd));
+    const double term3 = PI/xed*(yd+ywd);
+    const double term4 = PI/xed*(2*yed+abs(yd-ywd));
+    const double dterm1 = 1.-exp(-term1);
+    const double dterm2 = 1.-exp(-term2);
+    const double dterm3 = 1.-exp(-term3);
+    const double dterm4 = 1.-exp(-term4);
+    const double aydywd = abs(yd-ywd);
+    const double ydPywd = yd + ywd;
+    double ek_term, ek_, sexp_, kpiOxed, elem, A, d, ans = 0.;
+    for (int k = 1; k <= KMAX; ++k) {
+        ek_term = k*PI/xede;
+        ek_ = sqrt(u + ek_term*ek_term + alpha*alpha);
+        sexp_ = SEXP(yed, ek_);
+        kpiOxed = k*PI/xed;
+        elem = 1./ek_*((Images<B>::mirror*(std::exp(-ek_*(2.*yed - ydPywd)) + std::exp(-ek_*ydPywd)) + std::exp(-ek_*(2.*yed-aydywd)))*(1 + sexp_)
+                + std::exp(-ek_*aydywd)*sexp_);
+        ans += elem*Images<B>::mode(kpiOxed*xd)*Images<B>::mode(kpiOxed*xwd);
+        A = 2*xed/PI/(1-exp(-2*ek_*yed));
+        d = A*(exp(-k*term1)/dterm1+exp(-k*term2)/dterm2+exp(-k*term3)/dterm3 + exp(-k*term4)/dterm4);
+        if (isnan(d)) d = 0.;
+        if (k > KMIN && (abs(d) <= TINY || abs(ans) <= TINY || abs(d*kpiOxed/ans) < SUM_EPS)) break;
     }
-    for (int i = 1; i < 2*NSEG - 1; ++i) {
-        for (int j = 0; j < 2*NSEG; ++j) {
-            if (j >= i) {
-                matrix(i,j) = matrix(0, j-i);
-            }
-            else {
-                matrix(i,j) = matrix(2*NSEG-1, 2*NSEG-1-i+j);
+    return ans;
+}
+
+template <Boundary B>
+double Well::pnt_i1f2h_yd(const double u,
+        const double xd, const double xwd, const double xed, const double xede,
+        const double yd, const double ywd,
+        const double alpha) const {
+    // sum over the x-images of K0 of the point source and its mirror -xwd, periods 2*xed
+    const double squ = sqrt(u+alpha*alpha);
+    const double dy2 = (yd-ywd)*(yd-ywd);
+    const double mult = xed/xede*0.5*xede/PI;
+    double ans = 0., elem;
+    for (int k = 0; k <= KMAX; ++k) {
+        elem = 0.;
+        for (double beta: {-1., 1.}) {
+            for (int sgn: {-1, 1}) {
+                if (k == 0 && sgn == 1) continue;
+                double dxk = xd + beta*xwd + sgn*2.*k*xed;
+                double r = squ*std::sqrt(dxk*dxk + dy2);
+                if (r > 0.) elem += (beta > 0. ? Images<B>::mirror : 1.)*bess.k0(r);
             }
         }
+        ans += mult*elem;
+        if (k > KMIN && (abs(ans) <= TINY || abs(mult*elem/ans) < SUM_EPS)) break;
+    }
+    return ans;
+}
+
+template <Boundary B, typename S>
+void Well::fill_i1f2h(const double u,
+        const double xwd, const S& xed, const S& xede, const double alpha,
+        MatrixS<S>& matrix, VectorS<S>& buf) const {
+    VectorS<S> first(2*NSEG), first_mirror(2*NSEG), mirror(2*NSEG);
+    vect_i1f2h<B, S>(u, xwd-1.+0.5*dx, xwd, xed, xede, alpha, first, first_mirror);
+    vect_i1f2h<B, S>(u, xwd+1.-0.5*dx, xwd, xed, xede, alpha, buf, mirror);
+    fill_toeplitz_hankel<S>(first, first_mirror, buf, mirror, matrix);
+}
+
+template <typename S>
+void Well::fill_toeplitz_hankel(const VectorS<S>& first, const VectorS<S>& first_mirror,
+        const VectorS<S>& last, const VectorS<S>& last_mirror, MatrixS<S>& matrix) const {
+    // the direct images depend on x_i - x_j, the mirrored ones on x_i + x_j:
+    // both are given by the first and the last rows
+    for (int i = 0; i < 2*NSEG; ++i) {
+        for (int j = 0; j < 2*NSEG; ++j) {
+            matrix(i,j) = j >= i ? first(j-i) : last(2*NSEG-1-i+j);
+            matrix(i,j) += i+j < 2*NSEG ? first_mirror(i+j) : last_mirror(i+j-2*NSEG+1);
+        }
     }
 }
 
+template <Boundary B, typename S>
 void Well::vect_i1f2h(const double u,
-        const double xd, const double xwd, const double xed, const double xede,
+        const double xd, const double xwd, const S& xed, const S& xede,
         const double alpha,
-        Eigen::VectorXd& buf) const {
-    buf = Eigen::VectorXd::Zero(2*NSEG);
+        VectorS<S>& buf) const {
+    VectorS<S> mirror(2*NSEG);
+    vect_i1f2h<B, S>(u, xd, xwd, xed, xede, alpha, buf, mirror);
+    buf += mirror;
+}
+
+template <Boundary B, typename S>
+void Well::vect_i1f2h(const double u,
+        const double xd, const double xwd, const S& xed, const S& xede,
+        const double alpha,
+        VectorS<S>& buf, VectorS<S>& mirror) const {
+    buf = VectorS<S>::Zero(2*NSEG);
+    mirror = VectorS<S>::Zero(2*NSEG);
     const double squ = sqrt(u+alpha*alpha);
-    int kmin = static_cast<int>(abs(0.5*(2./squ/xede-(-1.+(2*NSEG-1)*dx)/xed+(xwd-1+0.5*dx)/xed+xwd/xed)));
-    double dmult = 8.*dx*exp(squ*xede/xed*abs((xwd-1+0.5*dx) + xwd - (-1.+(2*NSEG-1)*dx)))/1.-exp(-squ*2.*xede); //?
-    double mult = xed/xede/squ*0.5*xede/PI;
-    double t1, t2, x1, x2, elem, d;
+    const double xed_ = ScalarValue(xed), xede_ = ScalarValue(xede);
+    int kmin = static_cast<int>(abs(0.5*(2./squ/xede_-(-1.+(2*NSEG-1)*dx)/xed_+(xwd-1+0.5*dx)/xed_+xwd/xed_)));
+    double dmult = 8.*dx*exp(squ*xede_/xed_*abs((xwd-1+0.5*dx) + xwd - (-1.+(2*NSEG-1)*dx)))/(1.-exp(-squ*2.*xede_)); // geometric tail of the images
+    S mult = xed/xede/squ*0.5*xede/PI;
+    S t1, t2, elem;
+    double x1, x2, xa, xb, d;
+    PROFILE_SCOPE(ProfKernel::VectI1f2h);
     for (int k = 0; k <=KMAX; ++k) {
+        PROFILE_COUNT(ProfKernel::VectI1f2h, terms, 1);
         for (double beta: {-1., 1.}) {
+            // beta = -1 is the source, beta = 1 its mirror at -xwd, where the segment [x1, x2] turns into [-x2, -x1]
+            VectorS<S>& part = beta < 0. ? buf : mirror;
+            const double sign = beta > 0. ? Images<B>::mirror : 1.;
             for (int j = 0; j < 2*NSEG; ++j) {
                 x1 = -1.+j*dx;
                 x2 = x1 + dx;
-                t1 = squ*xede*((xd)/xed+beta*xwd/xed-x2/xed-2.*k);
-                t2 = squ*xede*((xd)/xed+beta*xwd/xed-x1/xed-2.*k);
-                elem = mult*bess.abs_ik0ab(t1, t2);
+                xa = beta < 0. ? x2 : x1;
+                xb = beta < 0. ? x1 : x2;
+                t1 = squ*xede*((xd)/xed+beta*(xwd+xa)/xed-2.*k);
+                t2 = squ*xede*((xd)/xed+beta*(xwd+xb)/xed-2.*k);
+                elem = mult*abs_ik0ab(t1, t2);
                 if (k > 0) {
-                    t1 = squ*xede*((xd)/xed+beta*xwd/xed-x2/xed+2.*k);
-                    t2 = squ*xede*((xd)/xed+beta*xwd/xed-x1/xed+2.*k);
-                    elem += mult*bess.abs_ik0ab(t1, t2);
+                    t1 = squ*xede*((xd)/xed+beta*(xwd+xa)/xed+2.*k);
+                    t2 = squ*xede*((xd)/xed+beta*(xwd+xb)/xed+2.*k);
+                    elem += mult*abs_ik0ab(t1, t2);
                 }
-                buf(j) += elem;
+                part(j) += sign*elem;
             }
         }
-        d = dmult*exp(-squ*2*k*xede);
+        d = dmult*exp(-squ*2*k*xede_);
         if (isnan(d)) d = 0.;
-        if (k>kmin && (d <= TINY || buf(2*NSEG-1) <= TINY || abs(d/buf(2*NSEG-1)) < SUM_EPS)) break;
+        double last = abs(ScalarValue(buf(2*NSEG-1) + mirror(2*NSEG-1)));
+        if (k>kmin && (d <= TINY || last <= TINY || abs(d/last) < SUM_EPS)) break;
     }
 };
 
+template <Boundary B>
 void Well::vect_i1f2h_yd(const double u,
         const double xd, const double xwd, const double xed, const double xede,
         const double yd, const double ywd,
-        const double alpha, Eigen::VectorXd& buf) const {
+        const double alpha, Eigen::VectorXd& buf,
+        const int jbegin, const int jend) const {
+    Eigen::VectorXd mirror(2*NSEG);
+    vect_i1f2h_yd<B>(u, xd, xwd, xed, xede, yd, ywd, alpha, buf, mirror, jbegin, jend);
+    buf += mirror;
+}
+
+template <Boundary B>
+void Well::vect_i1f2h_yd(const double u,
+        const double xd, const double xwd, const double xed, const double xede,
+        const double yd, const double ywd,
+        const double alpha, Eigen::VectorXd& buf, Eigen::VectorXd& mirror,
+        const int jbegin, const int jend) const {
     double adyd = abs(ywd-yd);
     if (adyd < 1e-16)
     {
-        vect_i1f2h(u, xd, xwd, xed, xede, alpha, buf);
+        vect_i1f2h<B>(u, xd, xwd, xed, xede, alpha, buf, mirror);
     } else {
+        PROFILE_SCOPE(ProfKernel::VectI1f2hYd);
         buf = Eigen::VectorXd::Zero(2*NSEG);
+        mirror = Eigen::VectorXd::Zero(2*NSEG);
         const double squ = sqrt(u+alpha*alpha);
-        auto func = [this, adyd, squ](double x) {return this->bess.k0(squ*std::sqrt(x*x+adyd*adyd));};
-        double t1, t2, x1, x2, elem;
+        auto func = [this, adyd, squ](double x) {
+            PROFILE_COUNT(ProfKernel::VectI1f2hYd, evals, 1);
+            return this->bess.k0(squ*std::sqrt(x*x+adyd*adyd));
+        };
+        // integral over (t1, t2) of the even integrand, split at zero when the segment is under the point
+        auto integral = [&func](double t1, double t2) {
+            if (t1 > t2) std::swap(t1, t2);
+            if (t1 < 0. && t2 > 0.) return qromb(func, 0., -t1, INT_EPS) + qromb(func, 0., t2, INT_EPS);
+            return qromb(func, min(abs(t1), abs(t2)), max(abs(t1), abs(t2)), INT_EPS);
+        };
+        double x1, x2, xa, xb, elem, total;
         double mult = xed/xede*0.5*xede/PI;
         double eps_j;
         double eps_buf_norm = 0.;
         double buf_norm;
+        const double norm_mult = 2.*NSEG/(jend - jbegin); // the norms of a part of the segments as if of all of them
         for (int k = 0; k <=KMAX; ++k) {
+            PROFILE_COUNT(ProfKernel::VectI1f2hYd, terms, 1);
             eps_buf_norm = 0.;
             buf_norm = 0.;
-            for (int j = 0; j < 2*NSEG; ++j) {
+            for (int j = jbegin; j < jend; ++j) {
                 x1 = -1.+j*dx;
                 x2 = x1 + dx;
-                elem = 0.;
+                total = 0.;
                 for (double beta: {-1.,1.}) {
-                    t1 = abs(xede*((xd)/xed+beta*xwd/xed-x2/xed-2.*k));
-                    t2 = abs(xede*((xd)/xed+beta*xwd/xed-x1/xed-2.*k));
-                    if (t1 > t2) {
-                        double dum = t1;
-                        t1 = t2;
-                        t2 = dum;
-                    }
-                    elem += mult*qromb(func, t1, t2, INT_EPS);
-                    if (k > 0) {
-                        t1 = abs(xede*((xd)/xed+beta*xwd/xed-x2/xed+2.*k));
-                        t2 = abs(xede*((xd)/xed+beta*xwd/xed-x1/xed+2.*k));
-                        if (t1 > t2) {
-                            double dum = t1;
-                            t1 = t2;
-                            t2 = dum;
-                        }
-                        elem += mult*qromb(func, t1, t2, INT_EPS);
-                    }
+                    const double sign = beta > 0. ? Images<B>::mirror : 1.;
+                    xa = beta < 0. ? x2 : x1;
+                    xb = beta < 0. ? x1 : x2;
+                    elem = sign*mult*integral(xede*((xd)/xed+beta*(xwd+xa)/xed-2.*k), xede*((xd)/xed+beta*(xwd+xb)/xed-2.*k));
+                    if (k > 0)
+                        elem += sign*mult*integral(xede*((xd)/xed+beta*(xwd+xa)/xed+2.*k), xede*((xd)/xed+beta*(xwd+xb)/xed+2.*k));
+                    (beta < 0. ? buf : mirror)(j) += elem;
+                    total += elem;
                 }
-                buf(j) += elem;
-                buf_norm += buf(j)*buf(j);
-                eps_j = elem/buf(j);
+                double sum = buf(j) + mirror(j);
+                buf_norm += sum*sum;
+                eps_j = total/sum;
                 eps_buf_norm += eps_j*eps_j;
             }
-            if ((sqrt(buf_norm)*0.5/NSEG <= TINY) || (sqrt(eps_buf_norm)*0.5/NSEG < SUM_EPS)) break;
+            if ((sqrt(norm_mult*buf_norm)*0.5/NSEG <= TINY) || (sqrt(norm_mult*eps_buf_norm)*0.5/NSEG < SUM_EPS)) break;
         }
     }
 }
 
+template <Boundary B>
 void Well::vect_i1f2h_yd_verbose(const double u,
         const double xd, const double xwd, const double xed, const double xede,
         const double yd, const double ywd,
@@ -298,12 +878,12 @@ void Well::vect_i1f2h_yd_verbose(const double u,
     double adyd = abs(ywd-yd);
     if (adyd < 1e-16)
     {
-        vect_i1f2h(u, xd, xwd, xed, xede, alpha, buf);
+        vect_i1f2h<B>(u, xd, xwd, xed, xede, alpha, buf);
     } else {
         buf = Eigen::VectorXd::Zero(2*NSEG);
         const double squ = sqrt(u+alpha*alpha);
         auto func = [this, adyd, squ](double x) {return this->bess.k0(squ*std::sqrt(x*x+adyd*adyd));};
-        double t1, t2, x1, x2, elem;
+        double t1, t2, x1, x2, xa, xb, elem;
         double mult = xed/xede*0.5*xede/PI;
         double eps_j;
         double eps_buf_norm = 0.;
@@ -317,25 +897,28 @@ void Well::vect_i1f2h_yd_verbose(const double u,
                 x2 = x1 + dx;
                 elem = 0.;
                 for (double beta: {-1.,1.}) {
-                    t1 = abs(xede*((xd)/xed+beta*xwd/xed-x2/xed-2.*k));
-                    t2 = abs(xede*((xd)/xed+beta*xwd/xed-x1/xed-2.*k));
+                    const double sign = beta > 0. ? Images<B>::mirror : 1.;
+                    xa = beta < 0. ? x2 : x1;
+                    xb = beta < 0. ? x1 : x2;
+                    t1 = abs(xede*((xd)/xed+beta*(xwd+xa)/xed-2.*k));
+                    t2 = abs(xede*((xd)/xed+beta*(xwd+xb)/xed-2.*k));
                     if (t1 > t2) {
                         double dum = t1;
                         t1 = t2;
                         t2 = dum;
                     }
                     cerr << t1 << " " << t2 << endl;
-                    elem += mult*qromb(func, t1, t2, INT_EPS);
+                    elem += sign*mult*qromb(func, t1, t2, INT_EPS);
                     if (k > 0) {
-                        t1 = abs(xede*((xd)/xed+beta*xwd/xed-x2/xed+2.*k));
-                        t2 = abs(xede*((xd)/xed+beta*xwd/xed-x1/xed+2.*k));
+                        t1 = abs(xede*((xd)/xed+beta*(xwd+xa)/xed+2.*k));
+                        t2 = abs(xede*((xd)/xed+beta*(xwd+xb)/xed+2.*k));
                         if (t1 > t2) {
                             double dum = t1;
                             t1 = t2;
                             t2 = dum;
                         }
                         cerr << t1 << " " << t2 << endl;
-                        elem += mult*qromb(func, t1, t2, INT_EPS);
+                        elem += sign*mult*qromb(func, t1, t2, INT_EPS);
                     }
                 }
                 buf(j) += elem;
@@ -349,14 +932,100 @@ void Well::vect_i1f2h_yd_verbose(const double u,
 }
 
 
-void Well::fill_i2f2h(const double u, const double ywd, const double alpha, Eigen::MatrixXd& matrix) const {
+template <Boundary B, typename S>
+void Well::fill_i2f2h(const double u, const double ywd, const double alpha, MatrixS<S>& matrix) const {
+    if (!Images<B>::mean) {
+        matrix = MatrixS<S>::Zero(2*NSEG, 2*NSEG);
+        return;
+    }
     double squ = sqrt(u+alpha*alpha);
-    matrix = -0.5*exp(-squ*abs(ywd-ywd))/squ*(dx)*Eigen::MatrixXd::Ones(2*NSEG, 2*NSEG);
+    matrix = MatrixS<S>::Constant(2*NSEG, 2*NSEG, -0.5*exp(-squ*abs(ywd-ywd))/squ*(dx));
+}
+
+double Well::abs_ik0ab(const double x1, const double x2) const {
+    return bess.abs_ik0ab(x1, x2);
+}
+
+DualD Well::abs_ik0ab(const DualD& x1, const DualD& x2) const {
+    // d/dp int_{x1}^{x2} K0(|t|)dt = K0(|x2|)*dx2/dp - K0(|x1|)*dx1/dp
+    double k1 = x1.value() != 0. ? bess.k0(abs(x1.value())) : 0.;
+    double k2 = x2.value() != 0. ? bess.k0(abs(x2.value())) : 0.;
+    return DualD(bess.abs_ik0ab(x1.value(), x2.value()), k2*x2.derivatives() - k1*x1.derivatives());
 }
 
+template <Boundary B>
 void Well::vect_i2f2h_yd(const double u, const double yd, const double ywd, const double alpha, Eigen::VectorXd& buf) const {
+    buf = pnt_i2f2h_yd<B>(u, yd, ywd, alpha)*(dx)*Eigen::VectorXd::Ones(2*NSEG);
+}
+
+template <Boundary B>
+double Well::pnt_i2f2h_yd(const double u, const double yd, const double ywd, const double alpha) const {
+    if (!Images<B>::mean) return 0.;
     double squ = sqrt(u+alpha*alpha);
-    buf = -0.5*exp(-squ*abs(yd-ywd))/squ*(dx)*Eigen::VectorXd::Ones(2*NSEG);
+    return -0.5*exp(-squ*abs(yd-ywd))/squ;
+}
+
+template <Boundary B>
+void Well::image_sources(const double u, const double xwd, const double xed, const double xede,
+        const double ywd, const double alpha, const Eigen::VectorXd& weights,
+        std::vector<LineSource>& sources) const {
+    // vect_i1f2h_yd integrates K0 over t = xede/xed*(xd - s) with s the segment (direct images) or its mirror,
+    // shifted by 2*k*xed; the images stop where exp(-squ*2*k*xede) is below the treecode tolerance
+    const double squ = sqrt(u+alpha*alpha);
+    const double c = xede/xed;
+    const double mult = xed/xede*0.5*xede/PI;
+    const int kmax = min(KMAX, KMIN + static_cast<int>(ceil(-log(treecode_tol)/(2.*squ*xede))));
+    for (int k = -kmax; k <= kmax; ++k) {
+        for (double beta: {-1., 1.}) {
+            const double sign = beta > 0. ? Images<B>::mirror : 1.;
+            for (int j = 0; j < 2*NSEG; ++j) {
+                double x1 = -1.+j*dx;
+                double x2 = x1 + dx;
+                double s1 = c*(-beta*(xwd + x1) + 2.*k*xed), s2 = c*(-beta*(xwd + x2) + 2.*k*xed);
+                sources.push_back({min(s1, s2), max(s1, s2), ywd, sign*mult*weights(j)});
+            }
+        }
+    }
+}
+
+template <Boundary B>
+void Well::pd_lapl_treecode(const double u, const double xwd, const double xed, const double xede,
+        const std::vector<double>& ywds, const double yed, const double alpha,
+        const Eigen::VectorXd& weights, const Matrix3DV& grid, Matrix3DV& ans, int nthreads) const {
+    // MakeGreenVector.dot(weights) of fractures at ywds with 2*NSEG weights each: the cosine series and the
+    // constant terms point by point on the summed weights, the x-images of all the fractures by one K0Treecode
+    vector<LineSource> sources;
+    for (size_t l = 0; l < ywds.size(); ++l)
+        image_sources<B>(u, xwd, xed, xede, ywds[l], alpha, weights.segment(l*2*NSEG, 2*NSEG), sources);
+    PROFILE_SCOPE(ProfKernel::Treecode);
+    PROFILE_COUNT(ProfKernel::Treecode, terms, sources.size());
+    PROFILE_COUNT(ProfKernel::Treecode, evals, grid.size());
+    unique_ptr<K0Treecode> tree;
+    {
+        TRACE_SCOPE("treecode build", "sources", sources.size());
+        tree = make_unique<K0Treecode>(bess, sqrt(u+alpha*alpha), std::move(sources), treecode_tol);
+    }
+    ans = grid;
+    auto pages = NPaginate(ans, nthreads);
+    vector<future<void>> futures;
+    for (auto& page: pages) {
+        futures.push_back(async(launch::async, [&, u](auto pg) {
+            TRACE_SCOPE("treecode page", "points", pg.size());
+            Eigen::VectorXd buf(2*NSEG);
+            for (auto& p: pg) {
+                double val = tree->operator()(xede/xed*p.x, p.y);
+                for (size_t l = 0; l < ywds.size(); ++l) {
+                    auto w = weights.segment(l*2*NSEG, 2*NSEG);
+                    val += dx*w.sum()*(pnt_if1_yd<B>(u, p.y, ywds[l], yed, alpha) + pnt_i2f2h_yd<B>(u, p.y, ywds[l], alpha));
+                    vect_if2e_yd<B>(u, p.x, xwd, xed, xede, p.y, ywds[l], yed, alpha, buf);
+                    val += buf.dot(w);
+                }
+                p.val = PI/xed*val;
+            }
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
 }
 
 
@@ -364,12 +1033,10 @@ Fracture::Fracture(const Boundary boundary, const double xwd, const double xed,
         const double ywd, const double yed,
         const double Fcd, const double alpha): Well(),
                 xwd(xwd), xed(xed), xede(xed), ywd(ywd), yed(yed), Fcd(Fcd), alpha(alpha), boundary(boundary),
-                _src_matrix(MakeSrcMatrix()){
-    if (boundary != Boundary::NNNN) throw logic_error("not implemented");
-};
+                _src_matrix(MakeSrcMatrix()){};
 
 double Fracture::pd_lapl(const double u, const double xd, const double yd, const double zd) const {
-    Eigen::VectorXd svect = MakeMatrix(u).colPivHouseholderQr().solve(MakeRhs(u));
+    Eigen::VectorXd svect = SolveLinear(u);
     Eigen::VectorXd green = MakeGreenVector(u, xd, yd, zd);
     double ans = 0.;
     for (int i = 0; i < 2*NSEG; ++i) {
@@ -378,10 +1045,37 @@ double Fracture::pd_lapl(const double u, const double xd, const double yd, const
     return ans;
 };
 
+void Fracture::pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& ans, int nthread) const {
+    if (lowrank_tol <= 0. && treecode_tol <= 0.) {
+        LaplWell::pd_lapl_m(u, grid, ans, nthread);
+        return;
+    }
+    Eigen::VectorXd svect = SolveLinear(u);
+    if (treecode_tol > 0.) {
+        if (boundary == Boundary::CCCC)
+            pd_lapl_treecode<Boundary::CCCC>(u, xwd, xed, xede, {ywd}, yed, alpha, svect.segment(1, 2*NSEG), grid, ans, nthread);
+        else
+            pd_lapl_treecode<Boundary::NNNN>(u, xwd, xed, xede, {ywd}, yed, alpha, svect.segment(1, 2*NSEG), grid, ans, nthread);
+        return;
+    }
+    pd_lapl_lowrank(u, svect.segment(1, 2*NSEG), {xwd - 1., xwd + 1., ywd, ywd}, grid, ans, nthread);
+}
+
 
 
+GridSymmetry Fracture::symmetry() const {
+    // opposite sides have the same boundary condition, so the field is mirrored around the fracture center
+    // whenever the fracture sits in the middle of the drainage area along an axis
+    GridSymmetry ans;
+    ans.x = abs(xwd - 0.5*xed) <= SYM_EPS*xed;
+    ans.x0 = xwd;
+    ans.y = abs(ywd - 0.5*yed) <= SYM_EPS*yed;
+    ans.y0 = ywd;
+    return ans;
+}
+
 double Fracture::pwd_lapl(const double u) const {
-    return MakeMatrix(u).colPivHouseholderQr().solve(MakeRhs(u))(0);
+    return SolveLinear(u)(0);
 };
 
 double Fracture::qwd_lapl(const double u) const {
@@ -389,29 +1083,45 @@ double Fracture::qwd_lapl(const double u) const {
 }
 
 Eigen::MatrixXd Fracture::MakeMatrix(const double u) const {
-    Eigen::MatrixXd source_matrix_ = Eigen::MatrixXd::Zero(2*NSEG+1, 2*NSEG+1);
-    Eigen::MatrixXd if1_matrix_(2*NSEG, 2*NSEG),if2e_matrix_(2*NSEG, 2*NSEG), i1f2h_matrix_(2*NSEG, 2*NSEG), i2f2h_matrix_(2*NSEG, 2*NSEG);
-    Eigen::VectorXd if2e_buf_(2*NSEG), i1f2h_buf_(2*NSEG);
-    double mult = -1.*PI/xed;
+    if (boundary == Boundary::CCCC) return BuildMatrix<Boundary::CCCC, double>(u, xed, yed, _src_matrix);
+    return BuildMatrix<Boundary::NNNN, double>(u, xed, yed, _src_matrix);
+}
+
+Eigen::VectorXd Fracture::MakeRhs(const double u) const {
+    return BuildRhs<double>(u, Fcd);
+}
+
+Eigen::MatrixXd Fracture::MakeSrcMatrix() const {
+    return BuildSrcMatrix<double>(Fcd);
+}
+
+template <Boundary B, typename S>
+MatrixS<S> Fracture::BuildMatrix(const double u, const S& xed, const S& yed, const MatrixS<S>& src_matrix) const {
+    MatrixS<S> source_matrix_ = MatrixS<S>::Zero(2*NSEG+1, 2*NSEG+1);
+    MatrixS<S> if1_matrix_(2*NSEG, 2*NSEG),if2e_matrix_(2*NSEG, 2*NSEG), i1f2h_matrix_(2*NSEG, 2*NSEG), i2f2h_matrix_(2*NSEG, 2*NSEG);
+    VectorS<S> if2e_buf_(2*NSEG), i1f2h_buf_(2*NSEG);
+    const S& xede = xed;
+    S mult = -1.*PI/xed;
     for (int i = 0; i < 2*NSEG; ++i) {
         source_matrix_(i,0) = 1.;
         source_matrix_(2*NSEG, i+1) = 1.;
     }
-    fill_if1(u, ywd, yed, alpha, if1_matrix_);
-    fill_if2e(u, xwd, xed, xede, ywd, yed, alpha, if2e_matrix_, if2e_buf_);
-    fill_i1f2h(u, xwd, xed, xede, alpha, i1f2h_matrix_, i1f2h_buf_);
-    fill_i2f2h(u,  ywd, alpha, i2f2h_matrix_);
+    fill_if1<B, S>(u, ywd, yed, alpha, if1_matrix_);
+    fill_if2e<B, S>(u, xwd, xed, xede, ywd, yed, alpha, if2e_matrix_, if2e_buf_);
+    fill_i1f2h<B, S>(u, xwd, xed, xede, alpha, i1f2h_matrix_, i1f2h_buf_);
+    fill_i2f2h<B, S>(u,  ywd, alpha, i2f2h_matrix_);
     for (int i = 0; i < 2*NSEG; ++i) {
         for (int j = 0; j < 2*NSEG; ++j) {
-            source_matrix_(i, j+1) = mult*(if1_matrix_(i,j)+ if2e_matrix_(i,j)+i1f2h_matrix_(i,j)+ i2f2h_matrix_(i,j))+_src_matrix(i,j);
+            source_matrix_(i, j+1) = mult*(if1_matrix_(i,j)+ if2e_matrix_(i,j)+i1f2h_matrix_(i,j)+ i2f2h_matrix_(i,j))+src_matrix(i,j);
         }
     }
     return source_matrix_;
 }
 
-Eigen::VectorXd Fracture::MakeRhs(const double u) const {
-    Eigen::VectorXd rhs(2*NSEG+1);
-    double coef = PI/Fcd/NSEG/u;
+template <typename S>
+VectorS<S> Well::BuildRhs(const double u, const S& Fcd) const {
+    VectorS<S> rhs(2*NSEG+1);
+    S coef = PI/Fcd/NSEG/u;
     for (int i = 0; i < NSEG; ++i) {
         rhs(NSEG+i) = coef*(i+0.5);
         rhs(NSEG-i-1) = rhs[NSEG+i];
@@ -420,17 +1130,13 @@ Eigen::VectorXd Fracture::MakeRhs(const double u) const {
     return rhs;
 }
 
-Eigen::MatrixXd Fracture::MakeSrcMatrix() const {
-    Eigen::MatrixXd ans(2*NSEG, 2*NSEG);
-    for (int i = 0; i < 2*NSEG; ++i) {
-        for (int j = 0; j < 2*NSEG; ++j) {
-            ans(i,j) = 0.;
-        }
-    }
+template <typename S>
+MatrixS<S> Well::BuildSrcMatrix(const S& Fcd) const {
+    MatrixS<S> ans = MatrixS<S>::Zero(2*NSEG, 2*NSEG);
     double dx = 1./NSEG;
     double dx2_8 = 0.125*dx*dx;
     double dx2_2 = 0.5*dx*dx;
-    double coef = PI/Fcd;
+    S coef = PI/Fcd;
     for (int j = 0; j < NSEG; ++j) {
         ans(j+NSEG,j+NSEG) = coef*dx2_8;
         ans(NSEG-j-1, NSEG-j-1) = ans(j+NSEG,j+NSEG);
@@ -443,24 +1149,1200 @@ Eigen::MatrixXd Fracture::MakeSrcMatrix() const {
     return ans;
 }
 
-Eigen::VectorXd Fracture::MakeGreenVector(const double u, const double xd, const double yd, const double zd) const {
+Asymptote Well::Bilinear(const double Fcd) const {
+    // Cinco-Ley and Samaniego: pwd = pi/(Gamma(5/4)*sqrt(2*Fcd))*td^(1/4) up to td ~ 0.1/Fcd^2;
+    // the segments resolve it down to some td only, below that the asymptote is the better of the two
+    Asymptote ans;
+    const double c = PI/(tgamma(1.25)*sqrt(2.*Fcd));
+    ans.pwd = [c](const double td) {return c*pow(td, 0.25);};
+    ans.dpwd = [c](const double td) {return 0.25*c*pow(td, 0.25);};
+    ans.td = 0.1/Fcd/Fcd;
+    return ans;
+}
+
+Eigen::VectorXd Well::SolveLinear(const double u) const {
+    Eigen::MatrixXd matrix;
+    {
+        TRACE_SCOPE("matrix build", "u", u);
+        matrix = MakeMatrix(u);
+    }
+    PROFILE_SCOPE(ProfKernel::Solve);
+    TRACE_SCOPE("solve", "u", u);
+    return matrix.colPivHouseholderQr().solve(MakeRhs(u));
+}
+
+double Well::MakeGreenEntry(const double u, const double xd, const double yd, const double zd, const int j) const {
+    return MakeGreenVector(u, xd, yd, zd)(j);
+}
+
+void Well::pd_lapl_lowrank(const double u, const Eigen::VectorXd& weights, const SourceBox& box,
+        const Matrix3DV& grid, Matrix3DV& ans, int nthreads) const {
+    // the grid points are split in halves along the longer side of their bounding box until a cluster is
+    // LR_ETA of its diameter away from the sources or has LR_LEAF points. The Green vectors of a far cluster are
+    // a smooth function of the point, the cluster x segment block is replaced by the cross approximation
+    // sum_l c_l*r_l with partial pivoting (Bebendorf): r_l is the residual of the Green vector at the pivot point,
+    // c_l the residual of the pivot segment at all the points, so a rank r block costs r Green vectors and r
+    // one segment columns instead of a Green vector per point. The near clusters take the Green vector per point
+    ans = grid;
+    vector<PointXYZV*> pts;
+    pts.reserve(ans.size());
+    for (auto& p: ans)
+        pts.push_back(&p);
+    struct Cluster {
+        size_t begin, end;
+        bool far;
+    };
+    vector<Cluster> clusters;
+    function<void(size_t, size_t)> split = [&](size_t begin, size_t end) {
+        double xmin = pts[begin]->x, xmax = xmin, ymin = pts[begin]->y, ymax = ymin;
+        for (size_t i = begin; i < end; ++i) {
+            xmin = min(xmin, pts[i]->x);
+            xmax = max(xmax, pts[i]->x);
+            ymin = min(ymin, pts[i]->y);
+            ymax = max(ymax, pts[i]->y);
+        }
+        double gapx = max(0., max(box.x1 - xmax, xmin - box.x2));
+        double gapy = max(0., max(box.y1 - ymax, ymin - box.y2));
+        double diam = hypot(xmax - xmin, ymax - ymin);
+        if (hypot(gapx, gapy) >= LR_ETA*diam && end - begin > 1) {
+            clusters.push_back({begin, end, true});
+            return;
+        }
+        if (end - begin <= static_cast<size_t>(LR_LEAF) || diam == 0.) {
+            clusters.push_back({begin, end, false});
+            return;
+        }
+        const bool by_x = xmax - xmin >= ymax - ymin;
+        size_t mid = begin + (end - begin)/2;
+        nth_element(pts.begin() + begin, pts.begin() + mid, pts.begin() + end,
+                [by_x](const PointXYZV* a, const PointXYZV* b) {return by_x ? a->x < b->x : a->y < b->y;});
+        split(begin, mid);
+        split(mid, end);
+    };
+    if (!pts.empty()) split(0, pts.size());
+
+    auto direct = [this, u, &weights](PointXYZV* p) {
+        p->val = this->MakeGreenVector(u, p->x, p->y, p->z).dot(weights);
+    };
+    auto cross = [this, u, &weights, &pts, &direct](const Cluster& cl) {
+        const size_t m = cl.end - cl.begin;
+        TRACE_SCOPE("low-rank block", "points", m);
+        PROFILE_SCOPE(ProfKernel::LowRank);
+        PROFILE_COUNT(ProfKernel::LowRank, evals, m);
+        PointXYZV** p = pts.data() + cl.begin;
+        vector<Eigen::VectorXd> cs, rs;
+        vector<bool> used(m, false);
+        double norm2 = 0.; // squared Frobenius norm of the approximation
+        bool converged = false;
+        size_t i = 0;
+        for (size_t tried = 0; tried < m && static_cast<int>(cs.size()) < LR_MAX_RANK; ++tried) {
+            used[i] = true;
+            Eigen::VectorXd r = this->MakeGreenVector(u, p[i]->x, p[i]->y, p[i]->z);
+            for (size_t l = 0; l < cs.size(); ++l)
+                r -= cs[l](i)*rs[l];
+            Eigen::Index j;
+            double pivot = r.cwiseAbs().maxCoeff(&j);
+            if (pivot > TINY) {
+                r /= r(j);
+                Eigen::VectorXd c(m);
+                for (size_t q = 0; q < m; ++q)
+                    c(q) = used[q] && q != i ? 0. : this->MakeGreenEntry(u, p[q]->x, p[q]->y, p[q]->z, static_cast<int>(j));
+                for (size_t l = 0; l < cs.size(); ++l)
+                    c -= rs[l](j)*cs[l];
+                for (size_t q = 0; q < m; ++q)
+                    if (used[q] && q != i) c(q) = 0.; // the earlier pivot points are exact already
+                for (size_t l = 0; l < cs.size(); ++l)
+                    norm2 += 2.*cs[l].dot(c)*rs[l].dot(r);
+                const double step = c.squaredNorm()*r.squaredNorm();
+                norm2 += step;
+                cs.push_back(std::move(c));
+                rs.push_back(std::move(r));
+                if (step <= lowrank_tol*lowrank_tol*norm2) {
+                    converged = true;
+                    break;
+                }
+            }
+            // the next pivot is the largest entry of the last column among the points that are not pivots yet
+            size_t next = m;
+            double best = -1.;
+            for (size_t q = 0; q < m; ++q) {
+                if (used[q]) continue;
+                double a = cs.empty() ? 0. : abs(cs.back()(q));
+                if (a > best) {
+                    best = a;
+                    next = q;
+                }
+            }
+            if (next == m) {
+                converged = true; // every point is a pivot, the approximation is exact
+                break;
+            }
+            i = next;
+        }
+        if (!converged) {
+            PROFILE_COUNT(ProfKernel::LowRank, hits, m);
+            for (size_t q = 0; q < m; ++q)
+                direct(p[q]);
+            return;
+        }
+        PROFILE_COUNT(ProfKernel::LowRank, terms, cs.size());
+        Eigen::VectorXd vals = Eigen::VectorXd::Zero(m);
+        for (size_t l = 0; l < cs.size(); ++l)
+            vals += rs[l].dot(weights)*cs[l];
+        for (size_t q = 0; q < m; ++q)
+            p[q]->val = vals(q);
+    };
+
+    // the clusters are taken by the threads one by one, a near one costs much more than a far one of the same size
+    atomic<size_t> next(0);
+    vector<future<void>> futures;
+    for (int t = 0; t < max(nthreads, 1); ++t) {
+        futures.push_back(async(launch::async, [&]() {
+            for (size_t k = next++; k < clusters.size(); k = next++) {
+                const Cluster& cl = clusters[k];
+                if (cl.far) {
+                    cross(cl);
+                } else {
+                    TRACE_SCOPE("near block", "points", cl.end - cl.begin);
+                    PROFILE_COUNT(ProfKernel::LowRank, hits, cl.end - cl.begin);
+                    for (size_t q = cl.begin; q < cl.end; ++q)
+                        direct(pts[q]);
+                }
+            }
+        }));
+    }
+    for (auto& f: futures)
+        f.get();
+}
+
+Asymptotes Fracture::asymptotes() const {
+    Asymptotes ans;
+    if (alpha != 0.) return ans;
+    ans.early = Bilinear(Fcd);
+    const double l = max(xed, yed);
+    ans.late = Bounded(boundary, xed*yed, l*l/PI/PI);
+    return ans;
+}
+
+double Fracture::pwd_lapl_grad(const double u, Eigen::VectorXd& grad) const {
+    // forward-mode sensitivities: the system A(p)s = b(p) is built with dual numbers,
+    // A is factorized once and ds/dp = A^-1(db/dp - dA/dp*s) reuses the factorization
+    const DualD fcd_(Fcd, NPARAM, 0), xed_(xed, NPARAM, 1), yed_(yed, NPARAM, 2);
+    MatrixS<DualD> matrix = boundary == Boundary::CCCC ?
+            BuildMatrix<Boundary::CCCC, DualD>(u, xed_, yed_, BuildSrcMatrix<DualD>(fcd_)) :
+            BuildMatrix<Boundary::NNNN, DualD>(u, xed_, yed_, BuildSrcMatrix<DualD>(fcd_));
+    VectorS<DualD> rhs = BuildRhs<DualD>(u, fcd_);
+    const int n = matrix.rows();
+    Eigen::MatrixXd a(n, n);
+    Eigen::VectorXd b(n);
+    for (int i = 0; i < n; ++i) {
+        b(i) = rhs(i).value();
+        for (int j = 0; j < n; ++j)
+            a(i,j) = matrix(i,j).value();
+    }
+    auto qr = a.colPivHouseholderQr();
+    Eigen::VectorXd svect = qr.solve(b);
+    Eigen::MatrixXd drhs(n, NPARAM);
+    for (int i = 0; i < n; ++i) {
+        for (int p = 0; p < NPARAM; ++p) {
+            double da_s = 0.;
+            for (int j = 0; j < n; ++j)
+                da_s += matrix(i,j).derivatives()(p)*svect(j);
+            drhs(i,p) = rhs(i).derivatives()(p) - da_s;
+        }
+    }
+    Eigen::MatrixXd dsvect = qr.solve(drhs);
+    grad = dsvect.row(0).transpose();
+    return svect(0);
+}
+
+Eigen::VectorXd Fracture::MakeGreenVector(const double u, const double xd, const double yd, const double) const {
+    if (boundary == Boundary::CCCC) return GreenVector<Boundary::CCCC>(u, xd, yd);
+    return GreenVector<Boundary::NNNN>(u, xd, yd);
+}
+
+double Fracture::MakeGreenEntry(const double u, const double xd, const double yd, const double, const int j) const {
+    if (boundary == Boundary::CCCC) return GreenVector<Boundary::CCCC>(u, xd, yd, j, j + 1)(j);
+    return GreenVector<Boundary::NNNN>(u, xd, yd, j, j + 1)(j);
+}
+
+template <Boundary B>
+Eigen::VectorXd Fracture::GreenVector(const double u, const double xd, const double yd, const int jbegin, const int jend) const {
     Eigen::VectorXd ans(2*NSEG);
     Eigen::VectorXd buf(2*NSEG);
     double mult = PI/xed;
-    vect_if1_yd(u, yd, ywd, yed, alpha, buf);
+    vect_if1_yd<B>(u, yd, ywd, yed, alpha, buf);
     ans = mult*buf;
     buf = Eigen::VectorXd::Zero(2*NSEG);
-    vect_if2e_yd(u, xd, xwd, xed, xede,	yd, ywd, yed, alpha, buf);
+    vect_if2e_yd<B>(u, xd, xwd, xed, xede,	yd, ywd, yed, alpha, buf, jbegin, jend);
     ans += mult*buf;
     buf = Eigen::VectorXd::Zero(2*NSEG);
-    vect_i1f2h_yd(u, xd, xwd, xed, xede, yd, ywd, alpha, buf);
+    vect_i1f2h_yd<B>(u, xd, xwd, xed, xede, yd, ywd, alpha, buf, jbegin, jend);
     ans += mult*buf;
     buf = Eigen::VectorXd::Zero(2*NSEG);
-    vect_i2f2h_yd(u, yd, ywd, alpha, buf);
+    vect_i2f2h_yd<B>(u, yd, ywd, alpha, buf);
     ans += mult*buf;
     return ans;
 }
 
+FractureSweep::FractureSweep(const Boundary boundary, const std::vector<FractureCase>& cases):
+        boundary(boundary), cases(cases) {
+    if (cases.empty()) throw invalid_argument("FractureSweep: no cases\n");
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const FractureCase& c = cases[i];
+        if (!(c.Fcd > 0.)) throw invalid_argument("FractureSweep: Fcd must be positive\n");
+        auto same = [&c, &cases](const vector<size_t>& g) {
+            const FractureCase& r = cases[g[0]];
+            return r.xwd == c.xwd && r.xed == c.xed && r.ywd == c.ywd && r.yed == c.yed && r.alpha == c.alpha;
+        };
+        auto it = find_if(geometries.begin(), geometries.end(), same);
+        if (it == geometries.end()) geometries.push_back({i});
+        else it->push_back(i);
+    }
+    const FractureCase& c = cases[0];
+    engine = make_unique<Fracture>(boundary, c.xwd, c.xed, c.ywd, c.yed, c.Fcd, c.alpha);
+    unit_src = engine->BuildSrcMatrix<double>(1.);
+}
+
+size_t FractureSweep::Cases() const {
+    return cases.size();
+}
+
+size_t FractureSweep::Geometries() const {
+    return geometries.size();
+}
+
+template <Boundary B>
+Eigen::MatrixXd FractureSweep::Kernel(const double u, const FractureCase& c) const {
+    Eigen::MatrixXd ans = Eigen::MatrixXd::Zero(2*NSEG+1, 2*NSEG+1);
+    Eigen::MatrixXd if1(2*NSEG, 2*NSEG), if2e(2*NSEG, 2*NSEG), i1f2h(2*NSEG, 2*NSEG), i2f2h(2*NSEG, 2*NSEG);
+    Eigen::VectorXd if2e_buf(2*NSEG), i1f2h_buf(2*NSEG);
+    engine->fill_if1<B, double>(u, c.ywd, c.yed, c.alpha, if1);
+    engine->fill_if2e<B, double>(u, c.xwd, c.xed, c.xed, c.ywd, c.yed, c.alpha, if2e, if2e_buf);
+    engine->fill_i1f2h<B, double>(u, c.xwd, c.xed, c.xed, c.alpha, i1f2h, i1f2h_buf);
+    engine->fill_i2f2h<B, double>(u, c.ywd, c.alpha, i2f2h);
+    for (int i = 0; i < 2*NSEG; ++i) {
+        ans(i,0) = 1.;
+        ans(2*NSEG, i+1) = 1.;
+    }
+    ans.block(0, 1, 2*NSEG, 2*NSEG) = -PI/c.xed*(if1 + if2e + i1f2h + i2f2h);
+    return ans;
+}
+
+std::vector<std::vector<double>> FractureSweep::pwd(const std::vector<double>& tds, int nthreads) const {
+    // the nodes i*log(2)/td as InverseLaplace makes them, equal ones are solved once
+    vector<double> nodes;
+    for (double td: tds) {
+        double s_mult = log(2.)/td;
+        for (int i = 1; i <= NCOEF; ++i)
+            nodes.push_back(i*s_mult);
+    }
+    sort(nodes.begin(), nodes.end());
+    nodes.erase(unique(nodes.begin(), nodes.end()), nodes.end());
+    vector<pair<size_t, size_t>> items; // (geometry, node)
+    for (size_t g = 0; g < geometries.size(); ++g)
+        for (size_t n = 0; n < nodes.size(); ++n)
+            items.push_back({g, n});
+    vector<vector<double>> lapl(cases.size(), vector<double>(nodes.size()));
+    vector<future<void>> futures;
+    for (auto& page: NPaginate(items, nthreads)) {
+        futures.push_back(async(launch::async, [this, &nodes, &lapl](auto pg) {
+            for (auto& item: pg) {
+                const double u = nodes[item.second];
+                const vector<size_t>& geometry = geometries[item.first];
+                Eigen::MatrixXd kernel;
+                {
+                    TRACE_SCOPE("matrix build", "u", u);
+                    kernel = boundary == Boundary::CCCC ? Kernel<Boundary::CCCC>(u, cases[geometry[0]]) :
+                            Kernel<Boundary::NNNN>(u, cases[geometry[0]]);
+                }
+                PROFILE_SCOPE(ProfKernel::Solve);
+                TRACE_SCOPE("solve", "cases", geometry.size());
+                for (size_t i: geometry) {
+                    Eigen::MatrixXd matrix = kernel;
+                    matrix.block(0, 1, 2*NSEG, 2*NSEG) += unit_src/cases[i].Fcd;
+                    lapl[i][item.second] = matrix.colPivHouseholderQr().solve(engine->BuildRhs<double>(u, cases[i].Fcd))(0);
+                }
+            }
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
+    const vector<double>& stehf_coefs = engine->stehf_coefs;
+    vector<vector<double>> ans(cases.size(), vector<double>(tds.size()));
+    for (size_t j = 0; j < tds.size(); ++j) {
+        double s_mult = log(2.)/tds[j];
+        for (int i = 1; i <= NCOEF; ++i) {
+            double s = i*s_mult;
+            size_t n = lower_bound(nodes.begin(), nodes.end(), s) - nodes.begin();
+            for (size_t c = 0; c < cases.size(); ++c)
+                ans[c][j] += lapl[c][n]*s*stehf_coefs[i]/i;
+        }
+    }
+    return ans;
+}
+
+Vertical::Vertical(const Boundary boundary, const double xwd, const double xed,
+        const double ywd, const double yed,
+        const double rwd, const double alpha): Well(),
+                xwd(xwd), xed(xed), xede(xed), ywd(ywd), yed(yed), rwd(rwd), alpha(alpha), boundary(boundary) {
+    if (xwd - rwd <= 0. || xwd + rwd >= xed || ywd - rwd <= 0. || ywd + rwd >= yed)
+        throw invalid_argument("Vertical: the well crosses the drainage area boundary\n");
+};
+
+double Vertical::pd_lapl(const double u, const double xd, const double yd, const double) const {
+    // inside the wellbore the pressure is the wellbore pressure
+    double dx = xd - xwd, dy = yd - ywd;
+    if (dx*dx + dy*dy < rwd*rwd) return pwd_lapl(u);
+    return PointSource(u, xd, yd);
+}
+
+double Vertical::pwd_lapl(const double u) const {
+    return PointSource(u, xwd + rwd, ywd);
+}
+
+double Vertical::qwd_lapl(const double u) const {
+    return 1./u/u/pwd_lapl(u);
+}
+
+Asymptotes Vertical::asymptotes() const {
+    // the line source is infinite acting, -Ei(-rwd^2/(4td))/2, until the nearest side is felt
+    Asymptotes ans;
+    if (alpha != 0.) return ans;
+    const double rwd2 = rwd*rwd;
+    ans.early.pwd = [rwd2](const double td) {return -0.5*expint(-0.25*rwd2/td);};
+    ans.early.dpwd = [rwd2](const double td) {return 0.5*exp(-0.25*rwd2/td);};
+    const double dmin = min(min(xwd, xed - xwd), min(ywd, yed - ywd));
+    ans.early.td = 0.25*dmin*dmin;
+    const double l = max(xed, yed);
+    ans.late = Bounded(boundary, xed*yed, l*l/PI/PI);
+    return ans;
+}
+
+GridSymmetry Vertical::symmetry() const {
+    GridSymmetry ans;
+    ans.x = abs(xwd - 0.5*xed) <= SYM_EPS*xed;
+    ans.x0 = xwd;
+    ans.y = abs(ywd - 0.5*yed) <= SYM_EPS*yed;
+    ans.y0 = ywd;
+    return ans;
+}
+
+double Vertical::PointSource(const double u, const double xd, const double yd) const {
+    // the fracture Green function with the whole rate 2/u of the 2*NSEG segments at one point
+    double ans = boundary == Boundary::CCCC ? ImageSum<Boundary::CCCC>(u, xd, yd) : ImageSum<Boundary::NNNN>(u, xd, yd);
+    return PI/xed*2./u*ans;
+}
+
+template <Boundary B>
+double Vertical::ImageSum(const double u, const double xd, const double yd) const {
+    double ans = pnt_if1_yd<B>(u, yd, ywd, yed, alpha);
+    ans += pnt_if2e_yd<B>(u, xd, xwd, xed, xede, yd, ywd, yed, alpha);
+    ans += pnt_i1f2h_yd<B>(u, xd, xwd, xed, xede, yd, ywd, alpha);
+    ans += pnt_i2f2h_yd<B>(u, yd, ywd, alpha);
+    return ans;
+}
+
+Eigen::MatrixXd Vertical::MakeMatrix(const double) const {
+    throw logic_error("Vertical: there is no linear system for a point source\n");
+}
+
+Eigen::VectorXd Vertical::MakeRhs(const double) const {
+    throw logic_error("Vertical: there is no linear system for a point source\n");
+}
+
+Eigen::MatrixXd Vertical::MakeSrcMatrix() const {
+    throw logic_error("Vertical: there is no linear system for a point source\n");
+}
+
+Eigen::VectorXd Vertical::MakeGreenVector(const double u, const double xd, const double yd, const double) const {
+    return Eigen::VectorXd::Constant(1, PointSource(u, xd, yd));
+}
+
+static bool EquallySpaced(const std::vector<double>& ys, const double eps) {
+    for (size_t k = 2; k < ys.size(); ++k)
+        if (abs(ys[k] - ys[k-1] - (ys[1] - ys[0])) > eps) return false;
+    return true;
+}
+
+MultiFractured::MultiFractured(const Boundary boundary, const double xwd, const double xed,
+        const std::vector<double>& ywds, const double yed,
+        const double Fcd, const double alpha, const int nthreads): Well(),
+                xwd(xwd), xed(xed), xede(xed), yed(yed), Fcd(Fcd), alpha(alpha), ywds(ywds), nfrac(ywds.size()),
+                boundary(boundary), nthreads(max(nthreads, 1)),
+                uniform(EquallySpaced(ywds, SYM_EPS*yed)),
+                _src_matrix(MakeSrcMatrix()), last_iterations(0) {
+    if (ywds.empty()) throw invalid_argument("MultiFractured: no fractures\n");
+    for (int k = 0; k < nfrac; ++k) {
+        if (ywds[k] <= 0. || ywds[k] >= yed) throw invalid_argument("MultiFractured: fracture is out of the drainage area\n");
+        if (k > 0 && ywds[k] <= ywds[k-1]) throw invalid_argument("MultiFractured: fracture positions must increase\n");
+    }
+};
+
+double MultiFractured::pd_lapl(const double u, const double xd, const double yd, const double zd) const {
+    double pwd;
+    Eigen::VectorXd svect = Solve(u, pwd);
+    return MakeGreenVector(u, xd, yd, zd).dot(svect);
+}
+
+void MultiFractured::pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& ans, int nthread) const {
+    // one solve for all the points, pd_lapl would repeat it at each of them
+    double pwd;
+    Eigen::VectorXd svect = Solve(u, pwd);
+    if (treecode_tol > 0.) {
+        if (boundary == Boundary::CCCC)
+            pd_lapl_treecode<Boundary::CCCC>(u, xwd, xed, xede, ywds, yed, alpha, svect, grid, ans, nthread);
+        else
+            pd_lapl_treecode<Boundary::NNNN>(u, xwd, xed, xede, ywds, yed, alpha, svect, grid, ans, nthread);
+        return;
+    }
+    ans = grid;
+    auto pages = NPaginate(ans, nthread);
+    vector<future<void>> futures;
+    for (auto& page: pages) {
+        futures.push_back(async(launch::async, [this, u, &svect](auto pg) {
+            TRACE_SCOPE("grid page", "points", pg.size());
+            for (auto& p: pg)
+                p.val = MakeGreenVector(u, p.x, p.y, p.z).dot(svect);
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
+}
+
+double MultiFractured::pwd_lapl(const double u) const {
+    double pwd;
+    Solve(u, pwd);
+    return pwd;
+}
+
+double MultiFractured::qwd_lapl(const double u) const {
+    return 1./u/u/pwd_lapl(u);
+}
+
+GridSymmetry MultiFractured::symmetry() const {
+    GridSymmetry ans;
+    ans.x = abs(xwd - 0.5*xed) <= SYM_EPS*xed;
+    ans.x0 = xwd;
+    ans.y = true;
+    for (int k = 0; k < nfrac; ++k)
+        ans.y = ans.y && abs(ywds[k] + ywds[nfrac-1-k] - yed) <= SYM_EPS*yed;
+    ans.y0 = 0.5*yed;
+    return ans;
+}
+
+int MultiFractured::LastIterations() const {
+    return last_iterations;
+}
+
+int MultiFractured::BlockIndex(const int k, const int l) const {
+    // (k, l) and (l, k) share the block
+    int i = min(k, l), j = max(k, l);
+    return i*nfrac - i*(i-1)/2 + j - i;
+}
+
+template <Boundary B>
+void MultiFractured::CosineBlock(const double u, const double yd, const double ywd, Eigen::MatrixXd& block) const {
+    // if1 + if2e + i2f2h between fractures at yd and ywd: the cosine series of vect_if2e_yd is
+    // sum_k cos(k*pi*x_i/xed)*d_k*cos(k*pi*x_j/xed) over the segment centers, the sine one with constant pressure
+    const double aydywd = abs(yd - ywd), ydPywd = yd + ywd;
+    vector<double> d;
+    double dsum = 0.;
+    for (int k = 1; k <= KMAX; ++k) {
+        double kpiOxed = k*PI/xed;
+        double ek_term = k*PI/xede;
+        double ek_ = sqrt(u + ek_term*ek_term + alpha*alpha);
+        double sexp_ = SEXP(yed, ek_);
+        double dk = 2.*sin(0.5*kpiOxed*dx)/kpiOxed/ek_*((Images<B>::mirror*(exp(-ek_*(2.*yed - ydPywd)) + exp(-ek_*ydPywd))
+                + exp(-ek_*(2.*yed - aydywd)))*(1 + sexp_) + exp(-ek_*aydywd)*sexp_);
+        d.push_back(dk);
+        dsum += abs(dk);
+        if (k > KMIN && abs(dk) <= SUM_EPS*dsum) break;
+    }
+    int nk = d.size();
+    Eigen::MatrixXd cmat(2*NSEG, nk);
+    for (int k = 0; k < nk; ++k)
+        for (int i = 0; i < 2*NSEG; ++i)
+            cmat(i, k) = Images<B>::mode((k+1)*PI/xed*(xwd - 1. + (i + 0.5)*dx));
+    Eigen::Map<const Eigen::VectorXd> dk(d.data(), nk);
+    block.noalias() = cmat*dk.asDiagonal()*cmat.transpose();
+    block.array() += dx*(pnt_if1_yd<B>(u, yd, ywd, yed, alpha) + pnt_i2f2h_yd<B>(u, yd, ywd, alpha));
+}
+
+template <Boundary B>
+void MultiFractured::ImageBlock(const double u, const double dyd, Eigen::MatrixXd& block) const {
+    // i1f2h is Toeplitz in the direct images and Hankel in the mirrored ones, as in fill_i1f2h
+    PROFILE_SCOPE(ProfKernel::ImageBlock);
+    Eigen::VectorXd buf(2*NSEG);
+    if (dyd == 0.) {
+        fill_i1f2h<B, double>(u, xwd, xed, xede, alpha, block, buf);
+        return;
+    }
+    Eigen::VectorXd first(2*NSEG), first_mirror(2*NSEG), last(2*NSEG), last_mirror(2*NSEG);
+    vect_i1f2h_yd<B>(u, xwd - 1. + 0.5*dx, xwd, xed, xede, dyd, 0., alpha, first, first_mirror);
+    vect_i1f2h_yd<B>(u, xwd + 1. - 0.5*dx, xwd, xed, xede, dyd, 0., alpha, last, last_mirror);
+    fill_toeplitz_hankel<double>(first, first_mirror, last, last_mirror, block);
+}
+
+std::vector<Eigen::MatrixXd> MultiFractured::MakeBlocks(const double u) const {
+    vector<pair<int, int>> pairs;
+    for (int k = 0; k < nfrac; ++k)
+        for (int l = k; l < nfrac; ++l)
+            pairs.push_back({k, l});
+    auto parallel_for = [this](vector<size_t>& items, const function<void(size_t)>& func) {
+        vector<future<void>> futures;
+        for (auto& page: NPaginate(items, nthreads)) {
+            futures.push_back(async(launch::async, [&func](auto pg) {
+                for (size_t i: pg) func(i);
+            }, page));
+        }
+        for (auto& f: futures)
+            f.get();
+    };
+    // x-image blocks: with equal spacing the pairs (0, l) cover all distances, otherwise one per pair
+    vector<size_t> image_pairs, all_pairs(pairs.size());
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        all_pairs[p] = p;
+        if (!uniform || pairs[p].first == 0) image_pairs.push_back(p);
+    }
+    PROFILE_COUNT(ProfKernel::ImageBlock, hits, pairs.size() - image_pairs.size());
+    vector<Eigen::MatrixXd> images(pairs.size());
+    parallel_for(image_pairs, [&](size_t p) {
+        images[p].resize(2*NSEG, 2*NSEG);
+        double dyd = ywds[pairs[p].second] - ywds[pairs[p].first];
+        if (boundary == Boundary::CCCC) ImageBlock<Boundary::CCCC>(u, dyd, images[p]);
+        else ImageBlock<Boundary::NNNN>(u, dyd, images[p]);
+    });
+    vector<Eigen::MatrixXd> blocks(pairs.size());
+    const double mult = -1.*PI/xed;
+    parallel_for(all_pairs, [&](size_t p) {
+        int k = pairs[p].first, l = pairs[p].second;
+        Eigen::MatrixXd& block = blocks[BlockIndex(k, l)];
+        block.resize(2*NSEG, 2*NSEG);
+        if (boundary == Boundary::CCCC) CosineBlock<Boundary::CCCC>(u, ywds[k], ywds[l], block);
+        else CosineBlock<Boundary::NNNN>(u, ywds[k], ywds[l], block);
+        block = mult*(block + images[uniform ? static_cast<size_t>(l - k) : p]);
+        if (k == l) block += _src_matrix;
+    });
+    return blocks;
+}
+
+Eigen::VectorXd MultiFractured::Solve(const double u, double& pwd) const {
+    // rows: pwd + sum_l B^{kl}q^l = 0, sum q = 2*NSEG/u, so q = -pwd*z with B*z = 1
+    const int nseg = 2*NSEG, n = nfrac*nseg, nc = nfrac*MFRAC_COARSE;
+    vector<Eigen::MatrixXd> blocks = MakeBlocks(u);
+    vector<Eigen::PartialPivLU<Eigen::MatrixXd>> diag;
+    for (int k = 0; k < nfrac; ++k)
+        diag.emplace_back(blocks[BlockIndex(k, k)]);
+    // coarse space for the smooth coupling the diagonal blocks miss: orthonormal polynomials S along a fracture
+    // on the rows, (B^{kk})^-1*S on the fluxes, so the coarse matrix is S^T*B*V
+    Eigen::MatrixXd smooth(nseg, MFRAC_COARSE);
+    for (int i = 0; i < nseg; ++i)
+        for (int m = 0; m < MFRAC_COARSE; ++m)
+            smooth(i, m) = pow(-1. + (i + 0.5)*dx, m);
+    smooth = Eigen::HouseholderQR<Eigen::MatrixXd>(smooth).householderQ()*Eigen::MatrixXd::Identity(nseg, MFRAC_COARSE);
+    vector<Eigen::MatrixXd> coarse(nfrac);
+    for (int k = 0; k < nfrac; ++k)
+        coarse[k] = diag[k].solve(smooth);
+    Eigen::MatrixXd bv = Eigen::MatrixXd::Zero(n, nc);
+    for (int k = 0; k < nfrac; ++k)
+        for (int l = 0; l < nfrac; ++l)
+            bv.block(k*nseg, l*MFRAC_COARSE, nseg, MFRAC_COARSE).noalias() = blocks[BlockIndex(k, l)]*coarse[l];
+    Eigen::MatrixXd ec(nc, nc);
+    for (int k = 0; k < nfrac; ++k)
+        ec.middleRows(k*MFRAC_COARSE, MFRAC_COARSE).noalias() = smooth.transpose()*bv.middleRows(k*nseg, nseg);
+    Eigen::PartialPivLU<Eigen::MatrixXd> ec_lu(ec);
+    LinearOp op = [&](const Eigen::VectorXd& x, Eigen::VectorXd& y) {
+        y = Eigen::VectorXd::Zero(n);
+        for (int k = 0; k < nfrac; ++k)
+            for (int l = 0; l < nfrac; ++l)
+                y.segment(k*nseg, nseg).noalias() += blocks[BlockIndex(k, l)]*x.segment(l*nseg, nseg);
+    };
+    LinearOp prec = [&](const Eigen::VectorXd& x, Eigen::VectorXd& y) {
+        // coarse correction, then the diagonal blocks on the rest
+        Eigen::VectorXd c(nc);
+        for (int k = 0; k < nfrac; ++k)
+            c.segment(k*MFRAC_COARSE, MFRAC_COARSE).noalias() = smooth.transpose()*x.segment(k*nseg, nseg);
+        c = ec_lu.solve(c);
+        Eigen::VectorXd r = x - bv*c;
+        y.resize(n);
+        for (int k = 0; k < nfrac; ++k)
+            y.segment(k*nseg, nseg) = coarse[k]*c.segment(k*MFRAC_COARSE, MFRAC_COARSE) + diag[k].solve(r.segment(k*nseg, nseg));
+    };
+    Eigen::VectorXd ones = Eigen::VectorXd::Ones(n), z = Eigen::VectorXd::Zero(n);
+    int iterations;
+    if (!GMRES(op, prec, ones, z, iterations, GMRES_TOL, MFRAC_GMRES_MAXIT)) {
+        Eigen::MatrixXd dense(n, n);
+        for (int k = 0; k < nfrac; ++k)
+            for (int l = 0; l < nfrac; ++l)
+                dense.block(k*nseg, l*nseg, nseg, nseg) = blocks[BlockIndex(k, l)];
+        z = dense.partialPivLu().solve(ones);
+    }
+    last_iterations = iterations;
+    pwd = -nseg/u/z.sum();
+    return -pwd*z;
+}
+
+Eigen::MatrixXd MultiFractured::MakeMatrix(const double u) const {
+    // the fluxes first and pwd last, the last row is the total rate
+    const int nseg = 2*NSEG, n = nfrac*nseg;
+    vector<Eigen::MatrixXd> blocks = MakeBlocks(u);
+    Eigen::MatrixXd ans = Eigen::MatrixXd::Zero(n+1, n+1);
+    for (int k = 0; k < nfrac; ++k)
+        for (int l = 0; l < nfrac; ++l)
+            ans.block(k*nseg, l*nseg, nseg, nseg) = blocks[BlockIndex(k, l)];
+    ans.col(n).head(n).setOnes();
+    ans.row(n).head(n).setOnes();
+    return ans;
+}
+
+Eigen::VectorXd MultiFractured::MakeRhs(const double u) const {
+    Eigen::VectorXd rhs = Eigen::VectorXd::Zero(nfrac*2*NSEG+1);
+    rhs(nfrac*2*NSEG) = 2.*NSEG/u;
+    return rhs;
+}
+
+Eigen::MatrixXd MultiFractured::MakeSrcMatrix() const {
+    // pressure drop along a fracture: the Fracture source matrix less the inflow from the wellbore,
+    // (pi/Fcd)*|x_i|*q_w with q_w = dx/2*sum of the fracture fluxes
+    Eigen::MatrixXd ans = BuildSrcMatrix(Fcd);
+    for (int i = 0; i < NSEG; ++i) {
+        double w = PI/Fcd*(i + 0.5)*dx*0.5*dx;
+        ans.row(NSEG+i).array() -= w;
+        ans.row(NSEG-i-1).array() -= w;
+    }
+    return ans;
+}
+
+Eigen::VectorXd MultiFractured::MakeGreenVector(const double u, const double xd, const double yd, const double) const {
+    if (boundary == Boundary::CCCC) return GreenVector<Boundary::CCCC>(u, xd, yd);
+    return GreenVector<Boundary::NNNN>(u, xd, yd);
+}
+
+template <Boundary B>
+Eigen::VectorXd MultiFractured::GreenVector(const double u, const double xd, const double yd) const {
+    Eigen::VectorXd ans(nfrac*2*NSEG);
+    Eigen::VectorXd green(2*NSEG), buf(2*NSEG);
+    double mult = PI/xed;
+    for (int k = 0; k < nfrac; ++k) {
+        vect_if1_yd<B>(u, yd, ywds[k], yed, alpha, green);
+        vect_if2e_yd<B>(u, xd, xwd, xed, xede, yd, ywds[k], yed, alpha, buf);
+        green += buf;
+        vect_i1f2h_yd<B>(u, xd, xwd, xed, xede, yd, ywds[k], alpha, buf);
+        green += buf;
+        vect_i2f2h_yd<B>(u, yd, ywds[k], alpha, buf);
+        green += buf;
+        ans.segment(k*2*NSEG, 2*NSEG) = mult*green;
+    }
+    return ans;
+}
+
+Horizontal::Horizontal(const Boundary boundary, const double xwd, const double xed,
+        const double ywd, const double yed,
+        const double zwd, const double hd, const double rwd, const double alpha): Well(),
+                xwd(xwd), xed(xed), xede(xed), ywd(ywd), yed(yed), zwd(zwd), hd(hd), rwd(rwd), alpha(alpha),
+                boundary(boundary), dimg(min(min(xwd - 1., xed - xwd - 1.), min(ywd, yed - ywd))) {
+    if (hd <= 0. || rwd <= 0.) throw invalid_argument("Horizontal: thickness and well radius must be positive\n");
+    if (dimg <= 0. || zwd - rwd <= 0. || zwd + rwd >= 1.)
+        throw invalid_argument("Horizontal: the well crosses the drainage area boundary\n");
+};
+
+double Horizontal::pd_lapl(const double u, const double xd, const double yd, const double zd) const {
+    // inside the wellbore the pressure is the wellbore pressure
+    double dyd = yd - ywd, dzd = hd*(zd - zwd);
+    if (abs(xd - xwd) <= 1. && dyd*dyd + dzd*dzd < hd*rwd*hd*rwd) return pwd_lapl(u);
+    Eigen::VectorXd svect = SolveLinear(u);
+    Eigen::VectorXd green = MakeGreenVector(u, xd, yd, zd);
+    return green.dot(svect.tail(2*NSEG));
+}
+
+double Horizontal::pwd_lapl(const double u) const {
+    return SolveLinear(u)(0);
+}
+
+double Horizontal::qwd_lapl(const double u) const {
+    return 1./u/u/pwd_lapl(u);
+}
+
+GridSymmetry Horizontal::symmetry() const {
+    GridSymmetry ans;
+    ans.x = abs(xwd - 0.5*xed) <= SYM_EPS*xed;
+    ans.x0 = xwd;
+    ans.y = abs(ywd - 0.5*yed) <= SYM_EPS*yed;
+    ans.y0 = ywd;
+    return ans;
+}
+
+double Horizontal::AlphaN(const int n) const {
+    double npi = n*PI/hd;
+    return sqrt(alpha*alpha + npi*npi);
+}
+
+double Horizontal::WeightN(const int n, const double zd) const {
+    return 2.*cos(n*PI*zd)*cos(n*PI*zwd);
+}
+
+template <Boundary B>
+void Horizontal::Green2D(const double u, const double alpha_n, Eigen::MatrixXd& matrix) const {
+    Eigen::MatrixXd buf_m(2*NSEG, 2*NSEG);
+    Eigen::VectorXd buf(2*NSEG);
+    fill_if1<B, double>(u, ywd, yed, alpha_n, matrix);
+    fill_if2e<B, double>(u, xwd, xed, xede, ywd, yed, alpha_n, buf_m, buf);
+    matrix += buf_m;
+    fill_i1f2h<B, double>(u, xwd, xed, xede, alpha_n, buf_m, buf);
+    matrix += buf_m;
+    fill_i2f2h<B, double>(u, ywd, alpha_n, buf_m);
+    matrix += buf_m;
+}
+
+template <Boundary B>
+void Horizontal::Green2DVector(const double u, const double xd, const double yd, const double alpha_n, Eigen::VectorXd& ans) const {
+    Eigen::VectorXd buf(2*NSEG);
+    vect_if1_yd<B>(u, yd, ywd, yed, alpha_n, ans);
+    vect_if2e_yd<B>(u, xd, xwd, xed, xede, yd, ywd, yed, alpha_n, buf);
+    ans += buf;
+    vect_i1f2h_yd<B>(u, xd, xwd, xed, xede, yd, ywd, alpha_n, buf);
+    ans += buf;
+    vect_i2f2h_yd<B>(u, yd, ywd, alpha_n, buf);
+    ans += buf;
+}
+
+void Horizontal::FreeRow(const double squ, Eigen::Ref<Eigen::VectorXd> row) const {
+    // row[m] is the free space K0 of a segment on the center of the one m segments away, the matrix is Toeplitz
+    const double mult = xed/squ*0.5/PI;
+    row.setZero();
+    for (int m = 0; m < 2*NSEG; ++m) {
+        double t1 = squ*(m - 0.5)*dx;
+        if (t1 > ZDECAY) break;
+        row[m] = mult*abs_ik0ab(t1, t1 + squ*dx);
+    }
+}
+
+void Horizontal::FreeVector(const double squ, const double sd, const double dyd, Eigen::Ref<Eigen::VectorXd> buf) const {
+    // free space K0 of every segment at the point sd = xd - xwd, dyd = |yd - ywd|
+    const double mult = xed*0.5/PI;
+    auto func = [this, dyd, squ](double x) {return this->bess.k0(squ*std::sqrt(x*x+dyd*dyd));};
+    buf.setZero();
+    for (int j = 0; j < 2*NSEG; ++j) {
+        double x1 = -1.+j*dx;
+        double x2 = x1 + dx;
+        double ex = max(max(x1 - sd, sd - x2), 0.);
+        if (squ*sqrt(ex*ex + dyd*dyd) > ZDECAY) continue;
+        if (dyd < 1e-16) {
+            buf[j] = mult/squ*abs_ik0ab(squ*(sd - x2), squ*(sd - x1));
+        } else {
+            double t1 = sd - x2, t2 = sd - x1;
+            if (t1 < 0. && t2 > 0.)
+                buf[j] = mult*(qromb(func, 0., -t1, INT_EPS) + qromb(func, 0., t2, INT_EPS));
+            else
+                buf[j] = mult*qromb(func, min(abs(t1), abs(t2)), max(abs(t1), abs(t2)), INT_EPS);
+        }
+    }
+}
+
+double Horizontal::ZTail(const double u, const int n0, const double dyd, const double zd) const {
+    // sum over n > n0 of w_n*xed/2*exp(-squ_n*dyd)/squ_n, the free space term of a segment on itself at large n:
+    // with squ_n -> n*pi/hd it is sum cos(n*theta)*exp(-n*beta)/n = -0.5*ln(1 - 2exp(-beta)cos(theta) + exp(-2beta))
+    // less its partial sum, the difference from squ_n decays as n^-3 and is summed directly
+    const double beta = PI*dyd/hd;
+    double ans = 0.;
+    for (double theta: {PI*(zd - zwd), PI*(zd + zwd)}) {
+        ans -= 0.5*log(1. - 2.*exp(-beta)*cos(theta) + exp(-2.*beta));
+        for (int n = 1; n <= n0; ++n)
+            ans -= cos(n*theta)*exp(-n*beta)/n;
+    }
+    ans *= hd/PI;
+    double corr = 0.;
+    for (int n = n0 + 1; n <= n0 + KMAX; ++n) {
+        double squ = sqrt(u + AlphaN(n)*AlphaN(n));
+        double npi = n*PI/hd;
+        double d = exp(-squ*dyd)/squ - exp(-npi*dyd)/npi;
+        corr += WeightN(n, zd)*d;
+        if (n > n0 + KMIN && 2.*abs(d) <= SUM_EPS*abs(ans + corr)) break;
+    }
+    return 0.5*xed*(ans + corr);
+}
+
+Eigen::MatrixXd Horizontal::MakeMatrix(const double u) const {
+    // collocation points are the segment centers on the wellbore surface zwd + rwd
+    const double zd = zwd + rwd;
+    Eigen::MatrixXd green(2*NSEG, 2*NSEG), buf(2*NSEG, 2*NSEG);
+    if (boundary == Boundary::CCCC) Green2D<Boundary::CCCC>(u, alpha, green);
+    else Green2D<Boundary::NNNN>(u, alpha, green);
+    int n = 1;
+    for (; sqrt(u + AlphaN(n)*AlphaN(n))*dimg <= ZDECAY; ++n) {
+        if (boundary == Boundary::CCCC) Green2D<Boundary::CCCC>(u, AlphaN(n), buf);
+        else Green2D<Boundary::NNNN>(u, AlphaN(n), buf);
+        green += WeightN(n, zd)*buf;
+    }
+    // the rest is the Toeplitz free space part, until a segment no longer sees its neighbours
+    Eigen::VectorXd toeplitz = Eigen::VectorXd::Zero(2*NSEG);
+    Eigen::MatrixXd rows(2*NSEG, NZBATCH);
+    Eigen::VectorXd weights(NZBATCH);
+    double squ = 0.;
+    while (squ*0.5*dx <= ZDECAY && n <= KMAX) {
+        for (int b = 0; b < NZBATCH; ++b, ++n) {
+            squ = sqrt(u + AlphaN(n)*AlphaN(n));
+            FreeRow(squ, rows.col(b));
+            weights[b] = WeightN(n, zd);
+        }
+        toeplitz += rows*weights;
+    }
+    toeplitz[0] += ZTail(u, n - 1, 0., zd);
+    Eigen::MatrixXd ans = Eigen::MatrixXd::Zero(2*NSEG+1, 2*NSEG+1);
+    double mult = -1.*PI/xed;
+    for (int i = 0; i < 2*NSEG; ++i) {
+        ans(i,0) = 1.;
+        ans(2*NSEG, i+1) = 1.;
+        for (int j = 0; j < 2*NSEG; ++j)
+            ans(i, j+1) = mult*(green(i,j) + toeplitz[abs(i-j)]);
+    }
+    return ans;
+}
+
+Eigen::VectorXd Horizontal::MakeRhs(const double u) const {
+    Eigen::VectorXd rhs = Eigen::VectorXd::Zero(2*NSEG+1);
+    rhs(2*NSEG) = 2.*NSEG/u;
+    return rhs;
+}
+
+Eigen::MatrixXd Horizontal::MakeSrcMatrix() const {
+    // infinite conductivity: no pressure drop along the wellbore
+    return Eigen::MatrixXd::Zero(2*NSEG, 2*NSEG);
+}
+
+Eigen::VectorXd Horizontal::MakeGreenVector(const double u, const double xd, const double yd, const double zd) const {
+    const double sd = xd - xwd, dyd = abs(yd - ywd);
+    Eigen::VectorXd green(2*NSEG), buf(2*NSEG);
+    if (boundary == Boundary::CCCC) Green2DVector<Boundary::CCCC>(u, xd, yd, alpha, green);
+    else Green2DVector<Boundary::NNNN>(u, xd, yd, alpha, green);
+    int n = 1;
+    for (; sqrt(u + AlphaN(n)*AlphaN(n))*dimg <= ZDECAY; ++n) {
+        if (boundary == Boundary::CCCC) Green2DVector<Boundary::CCCC>(u, xd, yd, AlphaN(n), buf);
+        else Green2DVector<Boundary::NNNN>(u, xd, yd, AlphaN(n), buf);
+        green += WeightN(n, zd)*buf;
+    }
+    // share of the segments in the closed form tail: the one under the point,
+    // halves of the two neighbours when the point is over an inner node, half of the end one over a tip
+    const bool over_well = abs(sd) <= 1. + SYM_EPS;
+    Eigen::VectorXd profile = Eigen::VectorXd::Zero(2*NSEG);
+    double dedge = dx;
+    if (over_well) {
+        double r = (min(max(sd, -1.), 1.) + 1.)/dx;
+        int jn = static_cast<int>(std::round(r));
+        if (abs(r - jn) <= SYM_EPS*2*NSEG) {
+            if (jn > 0) profile[jn-1] = 0.5;
+            if (jn < 2*NSEG) profile[jn] = 0.5;
+        } else {
+            int j = static_cast<int>(std::floor(r));
+            profile[j] = 1.;
+            dedge = min(r - j, j + 1 - r)*dx;
+        }
+    }
+    const double dxout = max(abs(sd) - 1., 0.);
+    const double rho = sqrt(dxout*dxout + dyd*dyd);
+    Eigen::MatrixXd rows(2*NSEG, NZBATCH);
+    Eigen::VectorXd weights(NZBATCH);
+    bool tail = false;
+    while (n <= KMAX) {
+        double squ = 0.;
+        for (int b = 0; b < NZBATCH; ++b, ++n) {
+            squ = sqrt(u + AlphaN(n)*AlphaN(n));
+            FreeVector(squ, sd, dyd, rows.col(b));
+            weights[b] = WeightN(n, zd);
+        }
+        green += rows*weights;
+        if (squ*rho > ZDECAY) break;
+        if (over_well && squ*dedge > ZDECAY) {
+            tail = true;
+            break;
+        }
+    }
+    if (tail) green += ZTail(u, n - 1, dyd, zd)*profile;
+    return PI/xed*green;
+}
+
+#define INSTANTIATE_KERNELS(B, S) \
+template void Well::fill_if1<B, S>(const double, const double, const S&, const double, MatrixS<S>&) const; \
+template void Well::fill_if2e<B, S>(const double, const double, const S&, const S&, const double, const S&, \
+        const double, MatrixS<S>&, VectorS<S>&) const; \
+template void Well::fill_i1f2h<B, S>(const double, const double, const S&, const S&, const double, \
+        MatrixS<S>&, VectorS<S>&) const; \
+template void Well::vect_i1f2h<B, S>(const double, const double, const double, const S&, const S&, const double, \
+        VectorS<S>&) const; \
+template void Well::fill_i2f2h<B, S>(const double, const double, const double, MatrixS<S>&) const;
+
+INSTANTIATE_KERNELS(Boundary::NNNN, double)
+INSTANTIATE_KERNELS(Boundary::NNNN, DualD)
+INSTANTIATE_KERNELS(Boundary::CCCC, double)
+INSTANTIATE_KERNELS(Boundary::CCCC, DualD)
+#undef INSTANTIATE_KERNELS
+
+template void Well::vect_i1f2h_yd<Boundary::NNNN>(const double, const double, const double, const double, const double,
+        const double, const double, const double, Eigen::VectorXd&, const int, const int) const;
+template void Well::vect_i1f2h_yd<Boundary::CCCC>(const double, const double, const double, const double, const double,
+        const double, const double, const double, Eigen::VectorXd&, const int, const int) const;
+
+}
+
+namespace Infinite {
+
+using Rectangular::NSEG;
+using Rectangular::INT_EPS;
+
+Fracture::Fracture(const double Fcd): Well(), Fcd(Fcd), _src_matrix(MakeSrcMatrix()) {};
+
+double Fracture::pd_lapl(const double u, const double xd, const double yd, const double zd) const {
+    Eigen::VectorXd svect = SolveLinear(u);
+    return MakeGreenVector(u, xd, yd, zd).dot(svect.tail(2*NSEG));
+}
+
+double Fracture::pwd_lapl(const double u) const {
+    return SolveLinear(u)(0);
+}
+
+double Fracture::qwd_lapl(const double u) const {
+    return 1./u/u/pwd_lapl(u);
+}
+
+GridSymmetry Fracture::symmetry() const {
+    GridSymmetry ans;
+    ans.x = true;
+    ans.y = true;
+    return ans;
+}
+
+Asymptotes Fracture::asymptotes() const {
+    // pseudo-radial flow: pwd = ln(td)/2 + c, u*pwd_lapl(u) = -(ln(u) + gamma)/2 + c + O(u*ln(u))
+    Asymptotes ans;
+    ans.early = Bilinear(Fcd);
+    const double u = 1e-8;
+    const double c = u*pwd_lapl(u) + 0.5*(log(u) + FastBessel::EUL_GAMMA_D);
+    ans.late.pwd = [c](const double td) {return 0.5*log(td) + c;};
+    ans.late.dpwd = [](const double) {return 0.5;};
+    ans.late.td = 100.;
+    return ans;
+}
+
+Eigen::MatrixXd Fracture::MakeMatrix(const double u) const {
+    const double squ = sqrt(u);
+    Eigen::VectorXd k0seg(2*NSEG);
+    for (int m = 0; m < 2*NSEG; ++m) {
+        k0seg(m) = abs_ik0ab(squ*(m-0.5)*dx, squ*(m+0.5)*dx)/squ;
+    }
+    Eigen::MatrixXd ans = Eigen::MatrixXd::Zero(2*NSEG+1, 2*NSEG+1);
+    for (int i = 0; i < 2*NSEG; ++i) {
+        ans(i,0) = 1.;
+        ans(2*NSEG, i+1) = 1.;
+        for (int j = 0; j < 2*NSEG; ++j) {
+            ans(i, j+1) = -0.5*k0seg(abs(i-j)) + _src_matrix(i,j);
+        }
+    }
+    return ans;
+}
+
+Eigen::VectorXd Fracture::MakeRhs(const double u) const {
+    return BuildRhs<double>(u, Fcd);
+}
+
+Eigen::MatrixXd Fracture::MakeSrcMatrix() const {
+    return BuildSrcMatrix<double>(Fcd);
+}
+
+Eigen::VectorXd Fracture::MakeGreenVector(const double u, const double xd, const double yd, const double) const {
+    const double squ = sqrt(u);
+    const double adyd = abs(yd);
+    Eigen::VectorXd ans(2*NSEG);
+    auto func = [this, adyd, squ](double x) {return this->bess.k0(squ*std::sqrt(x*x+adyd*adyd));};
+    for (int j = 0; j < 2*NSEG; ++j) {
+        double t1 = -1.+j*dx-xd, t2 = t1+dx;
+        if (adyd < 1e-16) {
+            ans(j) = 0.5*abs_ik0ab(squ*t1, squ*t2)/squ;
+        } else if (t1 < 0. && t2 > 0.) {
+            ans(j) = 0.5*(qromb(func, 0., -t1, INT_EPS) + qromb(func, 0., t2, INT_EPS));
+        } else {
+            ans(j) = 0.5*qromb(func, min(abs(t1), abs(t2)), max(abs(t1), abs(t2)), INT_EPS);
+        }
+    }
+    return ans;
+}
+
+}
+
+namespace Circular {
+
+using Rectangular::NSEG;
+using Rectangular::PI;
+
+static const double J1P0 = 3.831705970207512; // first zero of BesselJ[1,x], the slowest transient decays as exp(-J1P0^2*td/red^2)
+
+Vertical::Vertical(const Boundary boundary, const double red, const double rwd): LaplWell(),
+        bess(FastBessel::Bess::Shared()), red(red), rwd(rwd), boundary(boundary) {
+    if (rwd <= 0. || rwd >= red)
+        throw invalid_argument("Circular::Vertical: the well crosses the drainage area boundary\n");
+};
+
+double Vertical::pd_lapl(const double u, const double xd, const double yd, const double) const {
+    double rd = hypot(xd, yd);
+    if (rd < rwd) return pwd_lapl(u);
+    return LineSource(u, min(rd, red));
+}
+
+double Vertical::pwd_lapl(const double u) const {
+    return LineSource(u, rwd);
+}
+
+double Vertical::qwd_lapl(const double u) const {
+    return 1./u/u/pwd_lapl(u);
+}
+
+GridSymmetry Vertical::symmetry() const {
+    GridSymmetry ans;
+    ans.x = true;
+    ans.y = true;
+    return ans;
+}
+
+Asymptotes Vertical::asymptotes() const {
+    // -Ei(-rwd^2/(4td))/2 until the circle is felt, then pseudo-steady state
+    // 2td/red^2 + ln(red/rwd) - 3/4 + rwd^2/(2red^2) or steady state ln(red/rwd)
+    Asymptotes ans;
+    const double rwd2 = rwd*rwd;
+    ans.early.pwd = [rwd2](const double td) {return -0.5*expint(-0.25*rwd2/td);};
+    ans.early.dpwd = [rwd2](const double td) {return 0.5*exp(-0.25*rwd2/td);};
+    ans.early.td = 0.25*(red - rwd)*(red - rwd);
+    const double red2 = red*red;
+    if (boundary == Boundary::CCCC) {
+        const double b = log(red/rwd);
+        ans.late.pwd = [b](const double) {return b;};
+        ans.late.dpwd = [](const double) {return 0.;};
+    } else {
+        const double b = log(red/rwd) - 0.75 + 0.5*rwd2/red2;
+        ans.late.pwd = [b, red2](const double td) {return 2.*td/red2 + b;};
+        ans.late.dpwd = [red2](const double td) {return 2.*td/red2;};
+    }
+    ans.late.td = red2/J1P0/J1P0;
+    return ans;
+}
+
+double Vertical::LineSource(const double u, const double rd) const {
+    // A*I0 = A*exp(2*squ*red)*I0(squ*rd)*exp(-squ*rd)*exp(squ*(rd-2*red)) stays finite for large arguments
+    double squ = sqrt(u);
+    double a = squ*red;
+    double coef = boundary == Boundary::CCCC ? -bess.k0e(a)/bess.i0e(a) : bess.k1e(a)/bess.i1e(a);
+    return (bess.k0(squ*rd) + coef*bess.i0e(squ*rd)*exp(squ*(rd - 2.*red)))/u;
+}
+
+Fracture::Fracture(const Boundary boundary, const double red, const double Fcd): Infinite::Fracture(Fcd),
+        red(red), boundary(boundary) {
+    if (red <= 1.)
+        throw invalid_argument("Circular::Fracture: the fracture crosses the drainage area boundary\n");
+};
+
+Asymptotes Fracture::asymptotes() const {
+    Asymptotes ans;
+    ans.early = Bilinear(Fcd);
+    ans.late = Bounded(boundary, PI*red*red, red*red/J1P0/J1P0);
+    return ans;
+}
+
+double Fracture::BoundaryCoef(const double squ) const {
+    double a = squ*red;
+    return boundary == Boundary::CCCC ? -bess.k0e(a)/bess.i0e(a) : bess.k1e(a)/bess.i1e(a);
+}
+
+double Fracture::ScaledI0(const double squ, const double rd) const {
+    return bess.i0e(squ*rd)*exp(squ*(abs(rd) - red));
+}
+
+Eigen::VectorXd Fracture::SegmentI0(const double squ) const {
+    Eigen::VectorXd ans(2*NSEG);
+    auto func = [this, squ](double x) {return this->ScaledI0(squ, x);};
+    for (int j = 0; j < NSEG; ++j) {
+        ans(NSEG+j) = qgaus(func, j*dx, (j+1)*dx);
+        ans(NSEG-j-1) = ans(NSEG+j);
+    }
+    return ans;
+}
+
+Eigen::MatrixXd Fracture::MakeMatrix(const double u) const {
+    const double squ = sqrt(u);
+    const double coef = BoundaryCoef(squ);
+    Eigen::VectorXd col(2*NSEG);
+    for (int i = 0; i < 2*NSEG; ++i) {
+        col(i) = coef*ScaledI0(squ, -1.+(i+0.5)*dx);
+    }
+    Eigen::MatrixXd ans = Infinite::Fracture::MakeMatrix(u);
+    ans.block(0, 1, 2*NSEG, 2*NSEG) -= 0.5*col*SegmentI0(squ).transpose();
+    return ans;
+}
+
+Eigen::VectorXd Fracture::MakeGreenVector(const double u, const double xd, const double yd, const double zd) const {
+    double rd = hypot(xd, yd);
+    double scale = rd > red ? red/rd : 1.;
+    const double squ = sqrt(u);
+    return Infinite::Fracture::MakeGreenVector(u, scale*xd, scale*yd, zd) +
+            0.5*BoundaryCoef(squ)*ScaledI0(squ, min(rd, red))*SegmentI0(squ);
+}
+
+}
+
+bool GMRES(const LinearOp& op, const LinearOp& prec, const Eigen::VectorXd& b, Eigen::VectorXd& x,
+        int& iterations, const double tol, const int maxit) {
+    // Saad's restarted GMRES(m) with Givens rotations, x = prec(V*y) after every cycle
+    const int n = b.size(), m = min(GMRES_RESTART, n);
+    const double bnorm = b.norm() > 0. ? b.norm() : 1.;
+    Eigen::MatrixXd v(n, m+1), h = Eigen::MatrixXd::Zero(m+1, m);
+    Eigen::VectorXd g(m+1), cs(m), sn(m), w(n), z(n), r(n);
+    iterations = 0;
+    while (iterations < maxit) {
+        op(x, r);
+        r = b - r;
+        double beta = r.norm();
+        if (beta <= tol*bnorm) return true;
+        v.col(0) = r/beta;
+        g.setZero();
+        g(0) = beta;
+        h.setZero();
+        int j = 0;
+        bool done = false;
+        for (; j < m && iterations < maxit; ++j, ++iterations) {
+            prec(v.col(j), z);
+            op(z, w);
+            for (int i = 0; i <= j; ++i) {
+                h(i,j) = w.dot(v.col(i));
+                w -= h(i,j)*v.col(i);
+            }
+            h(j+1,j) = w.norm();
+            if (h(j+1,j) > 0.) v.col(j+1) = w/h(j+1,j);
+            for (int i = 0; i < j; ++i) {
+                double t = cs(i)*h(i,j) + sn(i)*h(i+1,j);
+                h(i+1,j) = -sn(i)*h(i,j) + cs(i)*h(i+1,j);
+                h(i,j) = t;
+            }
+            double den = hypot(h(j,j), h(j+1,j));
+            cs(j) = den > 0. ? h(j,j)/den : 1.;
+            sn(j) = den > 0. ? h(j+1,j)/den : 0.;
+            h(j,j) = den;
+            h(j+1,j) = 0.;
+            g(j+1) = -sn(j)*g(j);
+            g(j) *= cs(j);
+            if (abs(g(j+1)) <= tol*bnorm || den == 0.) {
+                ++j;
+                ++iterations;
+                done = true;
+                break;
+            }
+        }
+        Eigen::VectorXd y = h.topLeftCorner(j, j).triangularView<Eigen::Upper>().solve(g.head(j));
+        prec(v.leftCols(j)*y, z);
+        x += z;
+        if (done) {
+            op(x, r);
+            return (b - r).norm() <= 10.*tol*bnorm;
+        }
+    }
+    return false;
 }
 
 std::vector<double> CalcStehf(const int n) { //OK
@@ -2,6 +2,7 @@
 #define GWELL_H
 
 #include <Eigen/Dense>
+#include <unsupported/Eigen/AutoDiff>
 #include <cmath>
 #include <limits>
 #include <exception>
@@ -13,16 +14,37 @@
 #include <exception>
 #include <cassert>
 #include <algorithm>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
 #include "chbessel.h"
 #include "quadrature.h"
 #include "auxillary.h"
 #include "matrix3dv.h"
+#include "adaptivegrid.h"
+#include "profiler.h"
+#include "treecode.h"
 
 
 static const int NCOEF = 10;
 
+template <typename S> using MatrixS = Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic>;
+template <typename S> using VectorS = Eigen::Matrix<S, Eigen::Dynamic, 1>;
+
 std::vector<double> CalcStehf(const int n);
 
+static const int GMRES_RESTART = 50;
+static const int GMRES_MAXIT = 1000;
+static const double GMRES_TOL = 1e-10; // relative residual
+
+typedef std::function<void(const Eigen::VectorXd&, Eigen::VectorXd&)> LinearOp;
+// restarted GMRES with right preconditioning, solves op(x) = b starting from x, returns false if not converged
+bool GMRES(const LinearOp& op, const LinearOp& prec, const Eigen::VectorXd& b, Eigen::VectorXd& x,
+        int& iterations, const double tol = GMRES_TOL, const int maxit = GMRES_MAXIT);
+
 enum class WellType {
     Fracture,
     MultiFractured,
@@ -46,29 +68,83 @@ enum class MultifracOrientation {
     Parallel
 };
 
+static const double SYM_EPS = 1e-10; // points closer than SYM_EPS after folding are treated as mirror images
+
+struct GridSymmetry {
+    // mirror planes x = x0 and y = y0 of the pressure field
+    bool x = false;
+    bool y = false;
+    double x0 = 0.;
+    double y0 = 0.;
+};
+
+static const int SCHED_PTS_PER_DECADE = 10; // density of the log lag grid of tabulated step and ramp responses
+
+enum class RateInterp {
+    Step, // qds[k] acts on (tds_rate[k-1], tds_rate[k]], the first one from 0, the last one after tds_rate.back() too
+    Linear // linear between (tds_rate[k], qds[k]), qds[0] from 0 to tds_rate[0], constant after tds_rate.back()
+};
+
+static const double ASYMPT_TOL = 1e-3; // relative difference between an asymptote and the full solution at the crossover
+static const int ASYMPT_STEPS = 20; // halvings (early) or doublings (late) of td in the crossover search
+static const double SURR_EPS = 1e-10; // relative error of the surrogate pwd_lapl, Stehfest amplifies it by ~1e5
+static const int SURR_MIN_DEG = 16; // degrees of its Chebyshev series, doubled from the first to the last
+static const int SURR_MAX_DEG = 512;
+static const double LR_EPS = 1e-10; // relative tolerance of the cross approximation of the low-rank grid evaluation
+
+struct Asymptote {
+    // closed form pwd of a flow regime, empty when the well has none
+    std::function<double(const double)> pwd;
+    std::function<double(const double)> dpwd; // td*dpwd/dtd
+    double td = 0.; // start of the crossover search, inside the regime or close to its end
+};
+
+struct Asymptotes {
+    Asymptote early, late;
+};
+
 class LaplWell {
 public:
     LaplWell();
     virtual double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const = 0;
     virtual double pwd_lapl(const double u) const = 0;
     virtual double qwd_lapl(const double u) const = 0;
+    virtual GridSymmetry symmetry() const;
+    virtual double pwd_lapl_grad(const double u, Eigen::VectorXd& grad) const; // pwd_lapl and its gradient over well parameters
+    virtual Asymptotes asymptotes() const; // none by default
     virtual ~LaplWell();
 
-    double pwd(const double td) const;
+    double pwd(const double td) const; // the asymptotes outside of their crossovers, the inverse of pwd_lapl between them
+    double pwd_full(const double td) const; // always the inverse of pwd_lapl
+    void SetAsymptoteTolerance(const double tol); // off (0) by default, ASYMPT_TOL switches them on
+    void SetLowRankTolerance(const double tol); // of pd_lapl_m in the wells that have a low-rank mode, 0 switches it off
+    void SetTreecodeTolerance(const double tol); // of the K0 x-images in pd_lapl_m of the wells that have a treecode, the same
     double qwd(const double td) const;
     double pd(const double td, const double xd, const double yd, const double zd = 0.) const;
+    double pwd_grad(const double td, Eigen::VectorXd& grad) const;
     void pwd_parallel(const std::vector<double>& tds, std::vector<double>& pwds, int nthreads) const;
     void qwd_parallel(const std::vector<double>& tds, std::vector<double>& qwds, int nthreads) const;
+    void pwd_and_derivative(const std::vector<double>& tds, std::vector<double>& pwds, std::vector<double>& dpwds,
+            int nthreads) const; // pwd and td*dpwd/dtd (Bourdet derivative) from the same pwd_lapl calls
+    void pwd_schedule(const std::vector<double>& tds, const std::vector<double>& tds_rate, const std::vector<double>& qds,
+            std::vector<double>& pwds, int nthreads, const RateInterp interp = RateInterp::Step) const; // variable rate, qds relative to the rate of pwd
 
     Matrix3DV pd_m_parallel(const double td, int nthreads, const std::vector<double>& xs,
             const std::vector<double>& ys,
             const std::vector<double>& zs = {0.}) const;
+    void pd_m_parallel(const double td, int nthreads, Matrix3DV& grid, const bool use_symmetry = true) const; // fills vals of an arbitrary set of points
+    Matrix3DV pd_m_adaptive(const double td, int nthreads, const std::vector<double>& xs,
+            const std::vector<double>& ys,
+            const std::vector<double>& zs = {0.},
+            const double tol = ADAPT_EPS) const; // quadtree sampling over x-y, resampled to xs*ys*zs
     Matrix3DV pd_lapl_m(const double u, const Matrix3DV& grid, int nthread) const;
-    void pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const;
+    virtual void pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const;
 
 
     template <typename Func>
     double InverseLaplace(Func func, const double td) const {
+        PROFILE_SCOPE(ProfKernel::InverseLaplace);
+        PROFILE_COUNT(ProfKernel::InverseLaplace, evals, NCOEF);
         double s_mult = std::log(2.)/td;
         double ans = 0.;
         for (int i = 1; i <= NCOEF; ++i) {
@@ -94,6 +170,8 @@ public:
 
     template <typename Func>
     double InverseLaplaceXYZ(Func func, const double td, const double x, const double y, const double z = 0.) const {
+        PROFILE_SCOPE(ProfKernel::InverseLaplace);
+        PROFILE_COUNT(ProfKernel::InverseLaplace, evals, NCOEF);
         double s_mult = std::log(2.)/td;
         double ans = 0.;
         for (int i = 1; i <= NCOEF; ++i) {
@@ -114,6 +192,65 @@ public:
 
 protected:
     const std::vector<double> stehf_coefs;
+    double lowrank_tol;
+    double treecode_tol;
+    double LateConstant(const double slope, const double u) const; // b of pwd = slope*td + b from pwd_lapl near u = 0
+    Asymptote Bounded(const Boundary boundary, const double area, const double td) const; // pseudo-steady state (NNNN) or steady state (CCCC)
+    void pd_m_direct(const double td, int nthreads, Matrix3DV& grid) const;
+    void StepRampResponse(const std::vector<double>& lags, std::vector<double>& steps, std::vector<double>& ramps, int nthreads) const;
+    Matrix3DV FoldGrid(Matrix3DV& grid, const GridSymmetry& sym, std::vector<size_t>& index) const; // unique points of the fundamental region
+private:
+    // an asymptote is taken beyond the second of two successive td of the search where it agrees with pwd_full to asympt_tol,
+    // the crossovers are found on the first call of pwd
+    double asympt_tol;
+    mutable std::mutex asympt_mutex;
+    mutable bool asympt_ready;
+    mutable Asymptotes asympt;
+    mutable double td_early, td_late;
+    const Asymptote* Regime(const double td) const; // the asymptote that covers td or nullptr
+};
+
+class SkinWell: public LaplWell {
+    // wellbore skin on top of another well: pwd_lapl + skin/u, the reservoir pressure is unchanged
+public:
+    SkinWell(std::unique_ptr<LaplWell> well, const double skin);
+    using LaplWell::pd_lapl_m;
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    void pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const override;
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    Asymptotes asymptotes() const override;
+private:
+    const std::unique_ptr<LaplWell> well;
+    const double skin;
+};
+
+class SurrogateWell: public LaplWell {
+    // pwd_lapl of another well served from a Chebyshev series of log(u*pwd_lapl) in log(u) over the transforms
+    // that the Stehfest inversion of [td_min, td_max] takes. The series is interpolated at nested Chebyshev-Lobatto
+    // nodes, its degree is doubled until the previous one predicts the new nodes to eps; pwd_lapl outside of
+    // the range, pd_lapl and a well whose pwd_lapl is not positive go to the well itself
+public:
+    SurrogateWell(std::unique_ptr<LaplWell> well, const double td_min, const double td_max,
+            const int nthreads = 1, const double eps = SURR_EPS);
+    using LaplWell::pd_lapl_m;
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    void pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const override;
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    Asymptotes asymptotes() const override;
+    int Samples() const; // transforms of the well taken by the fit
+    double ErrorEstimate() const; // max relative error at the last nodes before the final doubling, infinity if there is no fit
+private:
+    const std::unique_ptr<LaplWell> well;
+    const double lumin, lumax; // log(u) range
+    std::vector<double> coefs;
+    int samples;
+    double error;
+    void Fit(const int nthreads, const double eps);
+    double Series(const std::vector<double>& c, const double t) const; // Clenshaw sum, t in [-1, 1]
 };
 
 namespace Rectangular {
@@ -125,6 +262,36 @@ static const int KMAX = 10000;
 static const int KMIN = 10;
 static const double PI = 3.141592653589793;
 static const double TINY = std::numeric_limits<double>::min();
+static const int NPARAM = 3; // parameters of pwd_lapl_grad: Fcd, xed, yed
+static const double LR_ETA = 1.; // a cluster of grid points is far from the sources beyond LR_ETA of its diameter
+static const int LR_LEAF = 32; // points of the clusters that are not split further
+static const int LR_MAX_RANK = NSEG/2; // a far cluster of a higher rank is evaluated point by point
+
+typedef Eigen::AutoDiffScalar<Eigen::Matrix<double, NPARAM, 1>> DualD; // dual number for forward-mode sensitivities
+
+double ScalarValue(const double x);
+double ScalarValue(const DualD& x);
+
+template <Boundary B>
+struct Images;
+
+template <>
+struct Images<Boundary::NNNN> {
+    // impermeable sides: the mirror images have the same sign, the x-series is the cosine one with the k = 0 term
+    static constexpr double mirror = 1.;
+    static constexpr bool mean = true;
+    static double mode(const double arg) { return std::cos(arg); }
+    static DualD mode(const DualD& arg) { return cos(arg); }
+};
+
+template <>
+struct Images<Boundary::CCCC> {
+    // constant pressure sides: the mirror images change sign, the x-series is the sine one without the k = 0 term
+    static constexpr double mirror = -1.;
+    static constexpr bool mean = false;
+    static double mode(const double arg) { return std::sin(arg); }
+    static DualD mode(const DualD& arg) { return sin(arg); }
+};
 
 class Well: public LaplWell {
 public:
@@ -132,54 +299,122 @@ public:
     virtual ~Well();
 
 protected:
-    const FastBessel::Bess bess;
+    const FastBessel::Bess& bess; // Bess::Shared
     const double dx;
 
     virtual Eigen::MatrixXd MakeMatrix(const double u) const = 0;
     virtual Eigen::VectorXd MakeRhs(const double u) const = 0;
     virtual Eigen::MatrixXd MakeSrcMatrix() const = 0;
     virtual Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const = 0;
+    template <typename S>
+    MatrixS<S> BuildSrcMatrix(const S& Fcd) const; // pressure drop along a finite conductivity fracture
+    template <typename S>
+    VectorS<S> BuildRhs(const double u, const S& Fcd) const; // its right hand side and the total rate
+    Asymptote Bilinear(const double Fcd) const; // its early time flow
+    Eigen::VectorXd SolveLinear(const double u) const; // the segment system of MakeMatrix and MakeRhs
+    virtual double MakeGreenEntry(const double u, const double xd, const double yd, const double zd, const int j) const; // MakeGreenVector(...)(j)
+    struct SourceBox {
+        double x1, x2, y1, y2;
+    };
+    void pd_lapl_lowrank(const double u, const Eigen::VectorXd& weights, const SourceBox& box,
+            const Matrix3DV& grid, Matrix3DV& ans, int nthreads) const; // MakeGreenVector.dot(weights) at the grid points
+    template <Boundary B>
+    void image_sources(const double u, const double xwd, const double xed, const double xede,
+            const double ywd, const double alpha, const Eigen::VectorXd& weights,
+            std::vector<LineSource>& sources) const; // x-images of vect_i1f2h_yd as sources of K0Treecode, x scaled by xede/xed
+    template <Boundary B>
+    void pd_lapl_treecode(const double u, const double xwd, const double xed, const double xede,
+            const std::vector<double>& ywds, const double yed, const double alpha,
+            const Eigen::VectorXd& weights, const Matrix3DV& grid, Matrix3DV& ans, int nthreads) const; // fractures at ywds
+
+    template <typename S>
+    S SEXP(const S& y, const S& e) const;
+    double abs_ik0ab(const double x1, const double x2) const;
+    DualD abs_ik0ab(const DualD& x1, const DualD& x2) const;
 
-    double SEXP(const double y, const double e) const;
+    // kernels are templates on the boundary type, fill_* are instantiated for double and DualD
+    template <Boundary B, typename S>
     void fill_if1(const double u,
-            const double ywd, const double yed,
+            const double ywd, const S& yed,
             const double alpha,
-            Eigen::MatrixXd& matrix) const;
+            MatrixS<S>& matrix) const;
+    template <Boundary B>
     void vect_if1_yd(const double u,
             const double yd, const double ywd, const double yed,
             const double alpha,
             Eigen::VectorXd& buf) const;
+    template <Boundary B>
+    double pnt_if1_yd(const double u,
+            const double yd, const double ywd, const double yed,
+            const double alpha) const; // point source limit of vect_if1_yd per unit length
 
+    template <Boundary B, typename S>
     void fill_if2e(const double u,
             const double xwd,
-            const double xed, const double xede,
-            const double ywd, const double yed,
+            const S& xed, const S& xede,
+            const double ywd, const S& yed,
             const double alpha,
-            Eigen::MatrixXd& matrix, Eigen::VectorXd& buf) const; // OK
+            MatrixS<S>& matrix, VectorS<S>& buf) const; // OK
+    template <Boundary B>
     void vect_if2e_yd(const double u, const double xd, const double xwd,
             const double xed, const double xede,
             const double yd, const double ywd, const double yed,
-            const double alpha, Eigen::VectorXd& buf) const;
+            const double alpha, Eigen::VectorXd& buf,
+            const int jbegin = 0, const int jend = 2*NSEG) const; // the segments [jbegin, jend) only, the rest is zero
+    template <Boundary B>
+    double pnt_if2e_yd(const double u, const double xd, const double xwd,
+            const double xed, const double xede,
+            const double yd, const double ywd, const double yed,
+            const double alpha) const;
 
+    template <Boundary B, typename S>
     void fill_i1f2h(const double u,
-            const double xwd, const double xed, const double xede, const double alpha,
-            Eigen::MatrixXd& matrix, Eigen::VectorXd& buf) const;
+            const double xwd, const S& xed, const S& xede, const double alpha,
+            MatrixS<S>& matrix, VectorS<S>& buf) const;
+    template <Boundary B, typename S>
     void vect_i1f2h(const double u,
-            const double xd, const double xwd, const double xed, const double xede,
+            const double xd, const double xwd, const S& xed, const S& xede,
             const double alpha,
-            Eigen::VectorXd& buf) const;
+            VectorS<S>& buf) const;
+    template <Boundary B, typename S>
+    void vect_i1f2h(const double u,
+            const double xd, const double xwd, const S& xed, const S& xede,
+            const double alpha,
+            VectorS<S>& buf, VectorS<S>& mirror) const; // the images of the source and of its mirror at -xwd apart
+    template <Boundary B>
+    void vect_i1f2h_yd(const double u,
+            const double xd, const double xwd, const double xed, const double xede,
+            const double yd, const double ywd,
+            const double alpha, Eigen::VectorXd& buf,
+            const int jbegin = 0, const int jend = 2*NSEG) const;
+    template <Boundary B>
     void vect_i1f2h_yd(const double u,
             const double xd, const double xwd, const double xed, const double xede,
             const double yd, const double ywd,
-            const double alpha, Eigen::VectorXd& buf) const;
+            const double alpha, Eigen::VectorXd& buf, Eigen::VectorXd& mirror,
+            const int jbegin = 0, const int jend = 2*NSEG) const; // off the fracture line the segments [jbegin, jend) only
+    template <typename S>
+    void fill_toeplitz_hankel(const VectorS<S>& first, const VectorS<S>& first_mirror,
+            const VectorS<S>& last, const VectorS<S>& last_mirror, MatrixS<S>& matrix) const;
 
+    template <Boundary B>
+    double pnt_i1f2h_yd(const double u,
+            const double xd, const double xwd, const double xed, const double xede,
+            const double yd, const double ywd,
+            const double alpha) const; // x-images of the point source K0 in closed form
+
+    template <Boundary B>
     void vect_i1f2h_yd_verbose(const double u,
                 const double xd, const double xwd, const double xed, const double xede,
                 const double yd, const double ywd,
                 const double alpha, Eigen::VectorXd& buf) const;
 
-    void fill_i2f2h(const double u, const double ywd, const double alpha, Eigen::MatrixXd& matrix) const;
+    template <Boundary B, typename S>
+    void fill_i2f2h(const double u, const double ywd, const double alpha, MatrixS<S>& matrix) const;
+    template <Boundary B>
     void vect_i2f2h_yd(const double u, const double yd, const double ywd, const double alpha, Eigen::VectorXd& buf) const;
+    template <Boundary B>
+    double pnt_i2f2h_yd(const double u, const double yd, const double ywd, const double alpha) const;
 
 };
 
@@ -191,9 +426,14 @@ public:
     ~Fracture() {
         std::cerr<<"Fracture destroyed" << std::endl;
     };
+    using LaplWell::pd_lapl_m;
     double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    void pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const override; // one solve, treecode or low-rank
     double pwd_lapl(const double u) const override;
     double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    double pwd_lapl_grad(const double u, Eigen::VectorXd& grad) const override; // grad over (Fcd, xed, yed) at fixed xwd, ywd
+    Asymptotes asymptotes() const override; // bilinear flow, pseudo-steady state or steady state
 private:
     const double xwd, xed, xede, ywd, yed, Fcd, alpha;
     const Boundary boundary;
@@ -202,7 +442,209 @@ private:
     Eigen::VectorXd MakeRhs(const double u) const override;
     Eigen::MatrixXd MakeSrcMatrix() const override;
     Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    double MakeGreenEntry(const double u, const double xd, const double yd, const double zd, const int j) const override;
+    template <Boundary B, typename S>
+    MatrixS<S> BuildMatrix(const double u, const S& xed, const S& yed, const MatrixS<S>& src_matrix) const;
+    template <Boundary B>
+    Eigen::VectorXd GreenVector(const double u, const double xd, const double yd,
+            const int jbegin = 0, const int jend = 2*NSEG) const;
+    friend class FractureSweep;
+};
 
+struct FractureCase {
+    double xwd, xed, ywd, yed, Fcd;
+    double alpha = 0.;
+};
+
+class FractureSweep {
+    // pwd of Fracture over many parameter sets of one boundary at common tds, the inverse of pwd_lapl as pwd_full.
+    // One Fracture is the kernel engine for all the cases; the Stehfest nodes common to several tds are solved
+    // once; the cases of the same geometry (all but Fcd) share the kernel blocks at a node, only the source
+    // matrix, which goes as 1/Fcd, and the rhs differ. The (geometry, node) pairs are spread over the threads
+public:
+    FractureSweep(const Boundary boundary, const std::vector<FractureCase>& cases);
+    std::vector<std::vector<double>> pwd(const std::vector<double>& tds, int nthreads) const; // [case][td]
+    size_t Cases() const;
+    size_t Geometries() const; // distinct cases up to Fcd
+private:
+    const Boundary boundary;
+    const std::vector<FractureCase> cases;
+    std::vector<std::vector<size_t>> geometries; // case indices
+    std::unique_ptr<Fracture> engine;
+    Eigen::MatrixXd unit_src; // source matrix at Fcd = 1
+    template <Boundary B>
+    Eigen::MatrixXd Kernel(const double u, const FractureCase& c) const; // Fracture::BuildMatrix without the source matrix
+};
+
+class Vertical: public Well {
+    // line source well of dimensionless radius rwd (lref = rw gives rwd = 1),
+    // the Green function is the point source limit of the fracture kernels, so no linear system is solved
+public:
+    Vertical(const Boundary boundary, const double xwd, const double xed,
+            const double ywd, const double yed,
+            const double rwd = 1., const double alpha = 0.);
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    Asymptotes asymptotes() const override; // infinite acting line source, pseudo-steady state or steady state
+private:
+    const double xwd, xed, xede, ywd, yed, rwd, alpha;
+    const Boundary boundary;
+    double PointSource(const double u, const double xd, const double yd) const;
+    template <Boundary B>
+    double ImageSum(const double u, const double xd, const double yd) const;
+    Eigen::MatrixXd MakeMatrix(const double u) const override;
+    Eigen::VectorXd MakeRhs(const double u) const override;
+    Eigen::MatrixXd MakeSrcMatrix() const override;
+    Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const override;
+};
+
+static const int MFRAC_COARSE = 6; // smooth modes per fracture in the coarse correction of the GMRES preconditioner
+static const int MFRAC_GMRES_MAXIT = 30; // about the cost of the dense LU of the assembled blocks, which takes over after it
+
+class MultiFractured: public Well {
+    // fractures of half-length 1 along x centered at xwd, ywds[k], joined by an infinite conductivity
+    // horizontal wellbore along y. The Green matrix is made of N x N blocks of 2*NSEG with G^{kl} = G^{lk}:
+    // the x-image K0 part depends on |ywds[k] - ywds[l]| only and is Toeplitz (Hankel for the mirror images),
+    // with equal spacing it is computed once per distance; the cosine series part (sine with constant pressure sides)
+    // is C*diag(d^{kl})*C^T with one C for all blocks.
+    // The upper triangle is built in parallel, the system is solved by GMRES preconditioned with the diagonal blocks
+    // and a coarse correction, the dense LU of the blocks is the fallback when GMRES stalls
+public:
+    MultiFractured(const Boundary boundary, const double xwd, const double xed,
+            const std::vector<double>& ywds, const double yed,
+            const double Fcd, const double alpha = 0., const int nthreads = 4);
+    using LaplWell::pd_lapl_m;
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    void pd_lapl_m(const double u, const Matrix3DV& grid, Matrix3DV& buf, int nthread) const override; // one solve per u
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    int LastIterations() const; // GMRES iterations of the last solve
+private:
+    const double xwd, xed, xede, yed, Fcd, alpha;
+    const std::vector<double> ywds;
+    const int nfrac;
+    const Boundary boundary;
+    const int nthreads;
+    const bool uniform; // equal spacing, pairs at the same distance share the x-image block
+    const Eigen::MatrixXd _src_matrix;
+    mutable std::atomic<int> last_iterations;
+    int BlockIndex(const int k, const int l) const;
+    template <Boundary B>
+    void CosineBlock(const double u, const double yd, const double ywd, Eigen::MatrixXd& block) const;
+    template <Boundary B>
+    void ImageBlock(const double u, const double dyd, Eigen::MatrixXd& block) const;
+    std::vector<Eigen::MatrixXd> MakeBlocks(const double u) const; // upper triangle row by row, the diagonal includes _src_matrix
+    Eigen::VectorXd Solve(const double u, double& pwd) const; // fluxes of all segments
+    Eigen::MatrixXd MakeMatrix(const double u) const override;
+    Eigen::VectorXd MakeRhs(const double u) const override;
+    Eigen::MatrixXd MakeSrcMatrix() const override;
+    Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    template <Boundary B>
+    Eigen::VectorXd GreenVector(const double u, const double xd, const double yd) const;
+};
+
+static const int NZBATCH = 8; // z harmonics whose free space rows are assembled together
+static const double ZDECAY = 30.; // exp(-ZDECAY) terms of the z harmonics are dropped
+
+class Horizontal: public Well {
+    // infinite conductivity horizontal well of half-length 1 along x in a slab of thickness hd,
+    // zwd and rwd are in the units of h, the wellbore pressure is taken at zwd + rwd.
+    // The Green function is sum_n w_n(zd)*G(u + alpha^2 + (n*pi/hd)^2), w_0 = 1, w_n = 2cos(n*pi*zd)cos(n*pi*zwd):
+    // the low harmonics use the full image kernels, the ones where the images have decayed use the free space
+    // K0 rows only, and beyond the one where a segment decouples from its neighbours the tail is summed in closed form
+public:
+    Horizontal(const Boundary boundary, const double xwd, const double xed,
+            const double ywd, const double yed,
+            const double zwd, const double hd, const double rwd, const double alpha = 0.);
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+private:
+    const double xwd, xed, xede, ywd, yed, zwd, hd, rwd, alpha;
+    const Boundary boundary;
+    const double dimg; // distance from the well to the nearest boundary, images decay as exp(-alpha_n*dimg)
+    double AlphaN(const int n) const;
+    double WeightN(const int n, const double zd) const;
+    template <Boundary B>
+    void Green2D(const double u, const double alpha_n, Eigen::MatrixXd& matrix) const;
+    template <Boundary B>
+    void Green2DVector(const double u, const double xd, const double yd, const double alpha_n, Eigen::VectorXd& buf) const;
+    void FreeRow(const double squ, Eigen::Ref<Eigen::VectorXd> row) const;
+    void FreeVector(const double squ, const double sd, const double dyd, Eigen::Ref<Eigen::VectorXd> buf) const;
+    double ZTail(const double u, const int n0, const double dyd, const double zd) const;
+    Eigen::MatrixXd MakeMatrix(const double u) const override;
+    Eigen::VectorXd MakeRhs(const double u) const override;
+    Eigen::MatrixXd MakeSrcMatrix() const override;
+    Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const override;
+};
+
+}
+
+namespace Infinite {
+
+class Fracture: public Rectangular::Well {
+    // finite conductivity fracture of half-length 1 along x centered at the origin of an infinite reservoir,
+    // the segments are those of Rectangular::Fracture. There are no images: the Green matrix is made of
+    // the direct K0 segment integrals, it depends on |i-j| only, so a system costs 2*NSEG Bess::ik0ab calls
+public:
+    Fracture(const double Fcd);
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    Asymptotes asymptotes() const override; // bilinear and pseudo-radial flow
+protected:
+    const double Fcd;
+    const Eigen::MatrixXd _src_matrix;
+    Eigen::MatrixXd MakeMatrix(const double u) const override;
+    Eigen::VectorXd MakeRhs(const double u) const override;
+    Eigen::MatrixXd MakeSrcMatrix() const override;
+    Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const override;
+};
+
+}
+
+namespace Circular {
+// wells in the center of a circle of dimensionless radius red, xd and yd are taken from the center.
+// The circle adds the regular solution A*I0(sqrt(u)*r) to the K0 of a source at its center,
+// A = K1/I1(sqrt(u)*red) for the closed (NNNN) and -K0/I0(sqrt(u)*red) for the constant pressure (CCCC) one;
+// points outside the circle get the pressure of the boundary along the same ray
+
+class Vertical: public LaplWell {
+    // line source well of dimensionless radius rwd (lref = rw gives rwd = 1)
+public:
+    Vertical(const Boundary boundary, const double red, const double rwd = 1.);
+    double pd_lapl(const double u, const double xd, const double yd, const double zd = 0.) const override;
+    double pwd_lapl(const double u) const override;
+    double qwd_lapl(const double u) const override;
+    GridSymmetry symmetry() const override;
+    Asymptotes asymptotes() const override; // infinite acting line source, pseudo-steady state or steady state
+private:
+    const FastBessel::Bess& bess; // Bess::Shared
+    const double red, rwd;
+    const Boundary boundary;
+    double LineSource(const double u, const double rd) const;
+};
+
+class Fracture: public Infinite::Fracture {
+    // the infinite reservoir fracture plus the circle, which acts on the axisymmetric mode of every segment only:
+    // its term A*I0(sqrt(u)*r)*I0(sqrt(u)*r') is of rank one; the flux along the fracture is even,
+    // so the first neglected mode is cos(2*theta), which falls as red^-4
+public:
+    Fracture(const Boundary boundary, const double red, const double Fcd);
+    Asymptotes asymptotes() const override; // bilinear flow, pseudo-steady state or steady state
+private:
+    const double red;
+    const Boundary boundary;
+    double BoundaryCoef(const double squ) const; // A*exp(2*squ*red)
+    double ScaledI0(const double squ, const double rd) const; // I0(squ*rd)*exp(-squ*red)
+    Eigen::VectorXd SegmentI0(const double squ) const; // integrals of ScaledI0 over the segments
+    Eigen::MatrixXd MakeMatrix(const double u) const override;
+    Eigen::VectorXd MakeGreenVector(const double u, const double xd, const double yd, const double zd = 0.) const override;
 };
 
 }
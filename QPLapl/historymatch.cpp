@@ -0,0 +1,232 @@
+#include "historymatch.h"
+
+using namespace std;
+
+std::string MatchReport::ToString() const {
+    static const char* names[NMATCH] = {"Fcd", "xed", "yed", "perm", "skin"};
+    const double vals[NMATCH] = {params.Fcd, params.xed, params.yed, params.perm, params.skin};
+    ostringstream os;
+    os << (converged ? "Converged: " : "Not converged: ") << message << "\n";
+    os << "Iterations: " << iterations << ", rms: " << (rmsHistory.empty() ? 0. : rmsHistory.back()) << "\n";
+    os << "Laplace solves: " << nSolves << ", cache hits: " << nCacheHits << "\n";
+    for (int k = 0; k < NMATCH; ++k)
+        os << names[k] << " = " << vals[k] << " +- " << stdErrors[k] << "\n";
+    return os.str();
+}
+
+HistoryMatcher::HistoryMatcher(const double xwd, const double ywd, const MatchData& data, int nthreads):
+    xwd(xwd), ywd(ywd), data(data), nthreads(nthreads), stehf_coefs(CalcStehf(NCOEF)), nSolves(0), nCacheHits(0) {
+    if (data.ts.size() != data.ys.size() || data.ts.empty())
+        throw invalid_argument("HistoryMatcher: measured series are empty or of different size\n");
+    for (double t: data.ts)
+        if (t <= 0.) throw invalid_argument("HistoryMatcher: measured times must be positive\n");
+    if (data.tdPerPerm <= 0. || data.scale <= 0.)
+        throw invalid_argument("HistoryMatcher: dimensionless scales must be positive\n");
+};
+
+std::vector<double> HistoryMatcher::Model(const MatchParams& p) {
+    Eigen::VectorXd model;
+    Eigen::MatrixXd jac;
+    Evaluate(p, model, jac);
+    return vector<double>(model.data(), model.data() + model.size());
+}
+
+MatchReport HistoryMatcher::Match(const MatchParams& init, const std::array<bool, NMATCH>& isFree) {
+    vector<int> cols;
+    for (int k = 0; k < NMATCH; ++k)
+        if (isFree[k]) cols.push_back(k);
+    int nfree = cols.size(), m = data.ys.size();
+    if (nfree == 0) throw invalid_argument("HistoryMatcher::Match: no free parameters\n");
+    if (m < nfree) throw invalid_argument("HistoryMatcher::Match: less measurements than free parameters\n");
+    Eigen::Map<const Eigen::VectorXd> ys(data.ys.data(), m);
+
+    MatchReport report;
+    report.converged = false;
+    report.iterations = 0;
+    report.stdErrors.fill(0.);
+    nSolves = nCacheHits = 0;
+
+    Eigen::VectorXd theta = ToTheta(init);
+    Clamp(theta);
+    Eigen::VectorXd model, trial_model;
+    Eigen::MatrixXd jac, trial_jac;
+    Evaluate(FromTheta(theta), model, jac);
+    Eigen::VectorXd res = model - ys;
+    double cost = 0.5*res.squaredNorm();
+    double lambda = LM_LAMBDA0;
+    report.rmsHistory.push_back(sqrt(2.*cost/m));
+    report.lambdaHistory.push_back(lambda);
+    report.message = "max number of iterations reached";
+
+    Eigen::MatrixXd jf(m, nfree);
+    while (report.iterations < LM_MAXIT) {
+        ++report.iterations;
+        for (int c = 0; c < nfree; ++c)
+            jf.col(c) = jac.col(cols[c]);
+        Eigen::MatrixXd jtj = jf.transpose()*jf;
+        Eigen::VectorXd jtr = jf.transpose()*res;
+        bool accepted = false;
+        while (!accepted) {
+            Eigen::MatrixXd a = jtj;
+            for (int c = 0; c < nfree; ++c)
+                a(c, c) += lambda*max(jtj(c, c), numeric_limits<double>::min());
+            Eigen::VectorXd step = a.ldlt().solve(-jtr);
+            Eigen::VectorXd trial = theta;
+            for (int c = 0; c < nfree; ++c)
+                trial[cols[c]] += step[c];
+            Clamp(trial);
+            double step_norm = (trial - theta).norm();
+            if (step_norm < LM_XTOL*(theta.norm() + LM_XTOL)) {
+                report.converged = true;
+                report.message = "parameter step is below tolerance";
+                break;
+            }
+            Evaluate(FromTheta(trial), trial_model, trial_jac);
+            Eigen::VectorXd trial_res = trial_model - ys;
+            double trial_cost = 0.5*trial_res.squaredNorm();
+            if (trial_cost < cost) {
+                accepted = true;
+                double reduction = (cost - trial_cost)/cost;
+                theta = trial;
+                res = trial_res;
+                jac.swap(trial_jac);
+                cost = trial_cost;
+                lambda = max(lambda/10., 1e-12);
+                report.rmsHistory.push_back(sqrt(2.*cost/m));
+                report.lambdaHistory.push_back(lambda);
+                if (reduction < LM_FTOL) {
+                    report.converged = true;
+                    report.message = "relative cost reduction is below tolerance";
+                }
+            } else {
+                lambda *= 10.;
+                if (lambda > LM_LAMBDA_MAX) {
+                    report.converged = true;
+                    report.message = "no descent direction, damping parameter limit reached";
+                    break;
+                }
+            }
+        }
+        if (report.converged || cost == 0.) {
+            if (cost == 0.) {
+                report.converged = true;
+                report.message = "exact fit";
+            }
+            break;
+        }
+    }
+
+    report.params = FromTheta(theta);
+    if (m > nfree) {
+        for (int c = 0; c < nfree; ++c)
+            jf.col(c) = jac.col(cols[c]);
+        double sigma2 = 2.*cost/(m - nfree);
+        Eigen::MatrixXd cov = (jf.transpose()*jf).ldlt().solve(Eigen::MatrixXd::Identity(nfree, nfree))*sigma2;
+        const double vals[NMATCH] = {report.params.Fcd, report.params.xed, report.params.yed, report.params.perm, 1.};
+        for (int c = 0; c < nfree; ++c)
+            report.stdErrors[cols[c]] = sqrt(max(cov(c, c), 0.))*vals[cols[c]]; // log space to linear for all but skin
+    }
+    report.nSolves = nSolves;
+    report.nCacheHits = nCacheHits;
+    return report;
+}
+
+double HistoryMatcher::LaplSolve(const Rectangular::Fracture& well, const MatchParams& p, const double u, Eigen::VectorXd& grad) {
+    LaplKey key = make_tuple(p.Fcd, p.xed, p.yed, u);
+    {
+        lock_guard<mutex> lock(cache_mutex);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            ++nCacheHits;
+            grad = it->second.second;
+            return it->second.first;
+        }
+    }
+    double ans = well.pwd_lapl_grad(u, grad);
+    lock_guard<mutex> lock(cache_mutex);
+    ++nSolves;
+    cache[key] = {ans, grad};
+    return ans;
+}
+
+void HistoryMatcher::Evaluate(const MatchParams& p, Eigen::VectorXd& model, Eigen::MatrixXd& jac) {
+    size_t m = data.ts.size();
+    model.resize(m);
+    jac.resize(m, NMATCH);
+    Rectangular::Fracture well(Boundary::NNNN, xwd, p.xed, ywd, p.yed, p.Fcd);
+    vector<size_t> rows(m);
+    for (size_t i = 0; i < m; ++i) rows[i] = i;
+    auto pages = NPaginate(rows, nthreads);
+    vector<future<void>> futures;
+    for (auto& page: pages) {
+        futures.push_back(async(launch::async, [this, &well, &p, &model, &jac](auto pg) {
+            for (size_t i: pg)
+                EvaluatePoint(well, p, data.ts[i], model[i], jac.row(i));
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
+}
+
+void HistoryMatcher::EvaluatePoint(const Rectangular::Fracture& well, const MatchParams& p, const double t,
+        double& y, Eigen::Ref<Eigen::RowVectorXd, 0, Eigen::InnerStride<>> dy) {
+    // f(td) is pwd with skin or qwd, fd = td*df/dtd is inverted from u*f(u)
+    // (Stehfest weights sum to zero, so the f(0) term does not contribute),
+    // df holds derivatives over Fcd, xed, yed, skin
+    double td = data.tdPerPerm*p.perm*t;
+    double s_mult = std::log(2.)/td;
+    double f = 0., fd = 0.;
+    Eigen::Vector4d df = Eigen::Vector4d::Zero();
+    Eigen::VectorXd g;
+    for (int i = 1; i <= NCOEF; ++i) {
+        double s = i*s_mult;
+        double mult = s*stehf_coefs[i]/i;
+        double pw = LaplSolve(well, p, s, g) + p.skin/s;
+        Eigen::Vector4d dpw(g[0], g[1], g[2], 1./s);
+        double fl;
+        Eigen::Vector4d dfl;
+        if (data.kind == MatchKind::Pressure) {
+            fl = pw;
+            dfl = dpw;
+        } else {
+            fl = 1./(s*s*pw);
+            dfl = -fl/pw*dpw;
+        }
+        f += fl*mult;
+        fd += s*fl*mult;
+        df += dfl*mult;
+    }
+    fd *= td;
+    const double vals[NMATCH-1] = {p.Fcd, p.xed, p.yed, 1.};
+    if (data.kind == MatchKind::Pressure) {
+        double a = data.scale/p.perm;
+        y = data.pInit - a*f;
+        for (int k = 0; k < NMATCH-1; ++k)
+            dy[k < 3 ? k : 4] = -a*df[k]*vals[k];
+        dy[3] = a*(f - fd);
+    } else {
+        double a = data.scale*p.perm;
+        y = a*f;
+        for (int k = 0; k < NMATCH-1; ++k)
+            dy[k < 3 ? k : 4] = a*df[k]*vals[k];
+        dy[3] = a*(f + fd);
+    }
+}
+
+Eigen::VectorXd HistoryMatcher::ToTheta(const MatchParams& p) const {
+    if (p.Fcd <= 0. || p.xed <= 0. || p.yed <= 0. || p.perm <= 0.)
+        throw invalid_argument("HistoryMatcher: Fcd, xed, yed and perm must be positive\n");
+    Eigen::VectorXd theta(NMATCH);
+    theta << log(p.Fcd), log(p.xed), log(p.yed), log(p.perm), p.skin;
+    return theta;
+}
+
+MatchParams HistoryMatcher::FromTheta(const Eigen::VectorXd& theta) const {
+    return {exp(theta[0]), exp(theta[1]), exp(theta[2]), exp(theta[3]), theta[4]};
+}
+
+void HistoryMatcher::Clamp(Eigen::VectorXd& theta) const {
+    // the fracture must stay inside the drainage area: xed >= xwd + 1, yed > ywd
+    theta[1] = max(theta[1], log(xwd + 1.));
+    theta[2] = max(theta[2], log(ywd*(1. + SYM_EPS) + SYM_EPS));
+}
@@ -0,0 +1,81 @@
+#ifndef HISTORYMATCH_H
+#define HISTORYMATCH_H
+
+#include <vector>
+#include <array>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include "gwell.h"
+
+static const int NMATCH = 5; // matched parameters: Fcd, xed, yed, perm, skin
+static const int LM_MAXIT = 50;
+static const double LM_FTOL = 1e-10; // relative cost reduction that stops iterations
+static const double LM_XTOL = 1e-8; // step norm that stops iterations
+static const double LM_LAMBDA0 = 1e-3;
+static const double LM_LAMBDA_MAX = 1e10;
+
+enum class MatchKind {
+    Pressure,
+    Rate
+};
+
+struct MatchParams {
+    double Fcd, xed, yed, perm, skin;
+};
+
+struct MatchData {
+    // measured series and the scales of the dimensionless model:
+    // td = tdPerPerm*perm*t
+    // Pressure: p = pInit - scale/perm*(pwd(td) + skin)
+    // Rate:     q = scale*perm*qwd(td), qwd is inverted from 1/(u^2*(pwd_lapl(u) + skin/u))
+    MatchKind kind;
+    std::vector<double> ts, ys;
+    double tdPerPerm;
+    double scale;
+    double pInit;
+};
+
+struct MatchReport {
+    MatchParams params;
+    std::array<double, NMATCH> stdErrors; // from the covariance estimate, 0. for fixed parameters
+    std::vector<double> rmsHistory; // rms of residuals after every accepted step
+    std::vector<double> lambdaHistory;
+    int iterations;
+    int nSolves; // Laplace space solves
+    int nCacheHits; // Laplace space solutions taken from cache
+    bool converged;
+    std::string message;
+    std::string ToString() const;
+};
+
+class HistoryMatcher {
+    // Levenberg-Marquardt fit of Rectangular::Fracture (NNNN) parameters, permeability and skin
+    // to a measured pressure or rate series. The Jacobian is assembled from pwd_lapl_grad and
+    // the inverse of u*f(u) (time derivative), parameters are fitted in log space except skin.
+public:
+    HistoryMatcher(const double xwd, const double ywd, const MatchData& data, int nthreads = 4);
+    MatchReport Match(const MatchParams& init,
+            const std::array<bool, NMATCH>& isFree = {true, true, true, true, true});
+    std::vector<double> Model(const MatchParams& p);
+private:
+    typedef std::tuple<double, double, double, double> LaplKey; // Fcd, xed, yed, u
+    const double xwd, ywd;
+    const MatchData data;
+    const int nthreads;
+    const std::vector<double> stehf_coefs;
+    std::map<LaplKey, std::pair<double, Eigen::VectorXd>> cache;
+    std::mutex cache_mutex;
+    int nSolves, nCacheHits;
+    double LaplSolve(const Rectangular::Fracture& well, const MatchParams& p, const double u, Eigen::VectorXd& grad);
+    void Evaluate(const MatchParams& p, Eigen::VectorXd& model, Eigen::MatrixXd& jac);
+    void EvaluatePoint(const Rectangular::Fracture& well, const MatchParams& p, const double t,
+            double& y, Eigen::Ref<Eigen::RowVectorXd, 0, Eigen::InnerStride<>> dy);
+    Eigen::VectorXd ToTheta(const MatchParams& p) const;
+    MatchParams FromTheta(const Eigen::VectorXd& theta) const;
+    void Clamp(Eigen::VectorXd& theta) const;
+};
+
+#endif // HISTORYMATCH_H
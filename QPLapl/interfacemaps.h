@@ -22,6 +22,11 @@ const QHash<QString, VisibilityState> wellpresVisibility = {
     {"Constant Liquid Rate", VisibilityState::Invisible},
     {"Constant Wellbore Pressure", VisibilityState::Visible}
 };
+
+const QHash<QString, VisibilityState> anyVisibility = {
+    {"Constant Liquid Rate", VisibilityState::Visible},
+    {"Constant Wellbore Pressure", VisibilityState::Visible}
+};
 }
 }
 
@@ -171,22 +176,22 @@ const QHash<QString, VisibilityState> reVisibility = {
 };
 const QHash<QString, VisibilityState> nLeftVisibility = {
     {"Rectangular", VisibilityState::Visible},
-    {"Infinite", VisibilityState::Invisible},
+    {"Infinite", VisibilityState::Visible},
     {"Cricled", VisibilityState::Invisible},
 };
 const QHash<QString, VisibilityState> nRightVisibility = {
     {"Rectangular", VisibilityState::Visible},
-    {"Infinite", VisibilityState::Invisible},
+    {"Infinite", VisibilityState::Visible},
     {"Cricled", VisibilityState::Invisible},
 };
 const QHash<QString, VisibilityState> nBottomVisibility = {
     {"Rectangular", VisibilityState::Visible},
-    {"Infinite", VisibilityState::Invisible},
+    {"Infinite", VisibilityState::Visible},
     {"Cricled", VisibilityState::Invisible},
 };
 const QHash<QString, VisibilityState> nTopVisibility = {
     {"Rectangular", VisibilityState::Visible},
-    {"Infinite", VisibilityState::Invisible},
+    {"Infinite", VisibilityState::Visible},
     {"Cricled", VisibilityState::Invisible},
 };
 const QHash<QString, VisibilityState> nWellVisibility = {
@@ -251,6 +256,11 @@ const QHash<QString, QString> DimentionlessConductivity = {
     {"US", "dimentionless"},
     {"SI", "dimentionless"}
 };
+const QHash<QString, QString> Dimentionless = {
+    {"Oilfield", "dimentionless"},
+    {"US", "dimentionless"},
+    {"SI", "dimentionless"}
+};
 const QHash<QString, QString> Permeability = {
     {"Oilfield", "md"},
     {"US", "md"},
@@ -149,3 +149,72 @@ err = myfunc.dy;
     return y;
 }
 
+
+Multilin_interp::Multilin_interp(const std::vector<std::vector<double>>& xv)
+: ndim(xv.size()), axes(xv), strides(ndim, 1), jlo(ndim, 0), t(ndim, 0.) {
+    for (int k = ndim - 2; k >= 0; --k)
+        strides[k] = strides[k+1]*axes[k+1].size();
+    for (int k = 0; k < ndim; ++k) {
+        if (axes[k].size() > 1)
+            terps.emplace_back(new Linear_interp(axes[k], axes[k]));
+        else
+            terps.emplace_back(nullptr);
+    }
+}
+
+bool Multilin_interp::inside(const std::vector<double>& x) const {
+    if (static_cast<int>(x.size()) != ndim) return false;
+    for (int k = 0; k < ndim; ++k) {
+        double lo = std::min(axes[k].front(), axes[k].back());
+        double hi = std::max(axes[k].front(), axes[k].back());
+        double eps = 1e-12*std::max(1., std::abs(hi));
+        if (x[k] < lo - eps || x[k] > hi + eps) return false;
+    }
+    return true;
+}
+
+bool Multilin_interp::weights(const std::vector<double>& x, std::vector<size_t>& nodes, std::vector<double>& w)
+// Returns false if x lies outside the lattice. Otherwise fills the 2^ndim flat indices of the
+// lattice nodes surrounding x and their weights (nodes of fixed axes are counted once).
+{
+    if (!inside(x)) return false;
+    for (int k = 0; k < ndim; ++k) {
+        if (!terps[k]) {
+            jlo[k] = 0;
+            t[k] = 0.;
+            continue;
+        }
+        Linear_interp& lt = *terps[k];
+        jlo[k] = lt.cor ? lt.hunt(x[k]) : lt.locate(x[k]);
+        const std::vector<double>& a = axes[k];
+        t[k] = (x[k]-a[jlo[k]])/(a[jlo[k]+1]-a[jlo[k]]);
+    }
+    nodes.assign(1, 0);
+    w.assign(1, 1.);
+    for (int k = 0; k < ndim; ++k) {
+        size_t n = nodes.size();
+        for (size_t i = 0; i < n; ++i)
+            nodes[i] += jlo[k]*strides[k];
+        if (!terps[k]) continue;
+        for (size_t i = 0; i < n; ++i) {
+            nodes.push_back(nodes[i] + strides[k]);
+            w.push_back(w[i]*t[k]);
+            w[i] *= 1.-t[k];
+        }
+    }
+    return true;
+}
+
+double Multilin_interp::interp(const std::vector<double>& x, const std::vector<double>& y) {
+    std::vector<size_t> nodes;
+    std::vector<double> w;
+    if (!weights(x, nodes, w)) throw("Multilin_interp: point outside lattice");
+    double ans = 0.;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        ans += w[i]*y[nodes[i]];
+    return ans;
+}
+
+size_t Multilin_interp::size() const {
+    return strides[0]*axes[0].size();
+}
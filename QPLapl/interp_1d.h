@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <vector>
+#include <memory>
 
 struct Base_interp {
     //Abstract class used for interpolation
@@ -48,5 +49,36 @@ to be used locally (polynomial order plus one), then call interp for interpolate
     double rawinterp(int jl, double x);
 };
 
+struct Multilin_interp
+/*
+Multilinear interpolation on a tensor lattice. Construct with the vector of lattice axes (each
+monotonic), then call interp with a point and the lattice values stored in row-major order
+(last axis changes fastest). Axes with a single node are treated as fixed parameters.
+Linear_interp objects are used to locate the point on every axis.
+
+USE:
+vector<vector<double>> axes = {x1v, x2v, x3v};
+vector<double> y(x1v.size()*x2v.size()*x3v.size());
+...
+Multilin_interp myfunc(axes);
+vector<size_t> nodes;
+vector<double> w;
+if (myfunc.weights({x1, x2, x3}, nodes, w)) {...}
+*/
+{
+    int ndim;
+    std::vector<std::vector<double>> axes;
+    std::vector<size_t> strides;
+    std::vector<int> jlo; // lower bracket index on every axis after the last call to weights
+    std::vector<double> t; // fractional position inside the bracket on every axis
+    Multilin_interp(const std::vector<std::vector<double>>& xv);
+    Multilin_interp(const Multilin_interp&) = delete;
+    bool inside(const std::vector<double>& x) const;
+    bool weights(const std::vector<double>& x, std::vector<size_t>& nodes, std::vector<double>& w);
+    double interp(const std::vector<double>& x, const std::vector<double>& y);
+    size_t size() const;
+private:
+    std::vector<std::unique_ptr<Linear_interp>> terps;
+};
 
 #endif // INTERP_1D_H
@@ -76,6 +76,10 @@ MainWindow::MainWindow(QWidget *parent)
     ui->layoutWellProps->addWidget(rwInput);
     rwInput->SetDefaultValue("0.1");
 
+    skinInput = new TextLineInput("Skin", unitsInput, Units::Maps::Dimentionless);
+    ui->layoutWellProps->addWidget(skinInput);
+    skinInput->SetDefaultValue("0");
+
     ui->layoutWellProps->addStretch(1);
 
     AlignLineInputs(ui->layoutWellProps);
@@ -199,9 +203,17 @@ MainWindow::MainWindow(QWidget *parent)
     nBetweenInput->AddVisibilityMap(WellRegimes::Maps::liqrateVisibility);
     ui->layoutGridSetup->addWidget(nBetweenInput);
 
+    adaptiveCheckBox = new CheckBoxHidable("Adaptive grid", regimeInput, WellRegimes::Maps::liqrateVisibility);
+    ui->layoutGridSetup->addWidget(adaptiveCheckBox);
+    lowRankCheckBox = new CheckBoxHidable("Low-rank grid", regimeInput, WellRegimes::Maps::liqrateVisibility);
+    ui->layoutGridSetup->addWidget(lowRankCheckBox);
+    treecodeCheckBox = new CheckBoxHidable("Treecode grid", regimeInput, WellRegimes::Maps::liqrateVisibility);
+    ui->layoutGridSetup->addWidget(treecodeCheckBox);
+
     ui->layoutGridSetup->addStretch(1);
 
     // setup Well Schedule
+    // both columns are shown: the one of the regime is its schedule, the other one the measured history
     wellSchedView = new PQTView(
                 liqrateInput,
                 wellpresInput,
@@ -210,9 +222,15 @@ MainWindow::MainWindow(QWidget *parent)
                 Units::Maps::LiquidRate,
                 Units::Maps::Pressure,
                 regimeInput,
-                WellRegimes::Maps::liqrateVisibility,
-                WellRegimes::Maps::wellpresVisibility);
+                WellRegimes::Maps::anyVisibility,
+                WellRegimes::Maps::anyVisibility);
     ui->layoutWellSched->addWidget(wellSchedView);
+    QHBoxLayout *historyLayout = new QHBoxLayout();
+    matchButton = new QPushButton("Match");
+    historyLayout->addWidget(matchButton);
+    deconvButton = new QPushButton("Deconvolve");
+    historyLayout->addWidget(deconvButton);
+    ui->layoutWellSched->addLayout(historyLayout);
     gridSchedView = new PQTView(
                 liqrateInput,
                 wellpresInput,
@@ -229,6 +247,8 @@ MainWindow::MainWindow(QWidget *parent)
     // grid check box
     gridCheckBox = new CheckBoxHidable("Calculate grid", regimeInput, WellRegimes::Maps::liqrateVisibility);
     ui->checkBoxLayout->addWidget(gridCheckBox);
+    surrogateCheckBox = new CheckBoxHidable("Laplace surrogate", regimeInput, WellRegimes::Maps::anyVisibility);
+    ui->checkBoxLayout->addWidget(surrogateCheckBox);
     /*
      *     TextComboLineInput *nRightInput;
     TextComboLineInput *nBottomInput;
@@ -245,9 +265,26 @@ MainWindow::MainWindow(QWidget *parent)
     connect(wellSchedView, &PQTView::CalcButtonPressed, this, &MainWindow::setupWellController);
     connect(this, &MainWindow::RunPQCalc, wellController, &WellController::CalculatePQ);
     connect(wellController, &WellController::GraphDataReady, graphWin, &PQGraphWindow::FillData);
+    connect(wellController, &WellController::DerivativeDataReady, graphWin, &PQGraphWindow::FillDerivative);
     connect(wellSchedView, &PQTView::ShowButtonPressed, graphWin, &PQGraphWindow::ShowGraph);
     connect(wellSchedView, &PQTView::SaveButtonPressed, this, &MainWindow::SavePQData);
     connect(graphWin, &PQGraphWindow::SaveData, this, &MainWindow::SavePQData);
+    // History connections
+    connect(matchButton, &QPushButton::pressed, this, &MainWindow::MatchHistory);
+    connect(wellController, &WellController::MatchReady, this, [this](const QString& report) {
+        fcdInput->SetDefaultValue(QString::number(wellController->fcd()));
+        xeInput->SetDefaultValue(QString::number(wellController->xed()*wellController->lref()));
+        yeInput->SetDefaultValue(QString::number(wellController->yed()*wellController->lref()));
+        permInput->SetDefaultValue(QString::number(wellController->permeability()));
+        skinInput->SetDefaultValue(QString::number(wellController->skinFactor()));
+        QMessageBox::information(this, "History match", report);
+    });
+    connect(deconvButton, &QPushButton::pressed, this, &MainWindow::Deconvolve);
+    connect(wellController, &WellController::DeconvolutionGraphReady, graphWin, &PQGraphWindow::FillDeconvolution);
+    connect(wellController, &WellController::DeconvolutionReportReady, this, [this](const QString& report) {
+        graphWin->ShowGraph();
+        QMessageBox::information(this, "Deconvolution", report);
+    });
     // Grid Connections
     connect(gridSchedView, &PQTView::CalcButtonPressed, this, &MainWindow::setupWellController);
     connect(this, &MainWindow::RunGridCalc, wellController, &WellController::CalculateGrid);
@@ -255,6 +292,16 @@ MainWindow::MainWindow(QWidget *parent)
     connect(gridSchedView, &PQTView::ShowButtonPressed, gridWin, &GridPlot::ShowGraph);
     connect(gridSchedView, &PQTView::SaveButtonPressed, this, &MainWindow::SaveGridData);
     connect(gridWin, &GridPlot::SaveData, this, &MainWindow::SaveGridData);
+    // kernel profile: totals in the status bar, the table in its tool tip
+    connect(wellController, &WellController::ProfileReady, this, [this](const QString& report) {
+        const ProfileReport& profile = wellController->getProfile();
+        ui->statusbar->showMessage(QString("Profile: %1 Laplace inversions, %2 td from asymptotes, %3 QR solves in %4 ms")
+                .arg(profile[ProfKernel::InverseLaplace].calls)
+                .arg(profile[ProfKernel::Pwd].hits)
+                .arg(profile[ProfKernel::Solve].calls)
+                .arg(1e-6*profile[ProfKernel::Solve].ns, 0, 'f', 1));
+        ui->statusbar->setToolTip("<pre>" + report.toHtmlEscaped() + "</pre>");
+    });
     gridSchedView->hide();
     // check box connections
     connect(gridCheckBox, &AbstractControlledHidable::WidgetVisibilityChanged, gridSchedView, &QWidget::setVisible);
@@ -269,6 +316,9 @@ MainWindow::MainWindow(QWidget *parent)
     connect(gridCheckBox, &CheckBoxHidable::SetChecked, nzBottomInput, &QWidget::setVisible);
     connect(gridCheckBox, &CheckBoxHidable::SetChecked, nzTopInput, &QWidget::setVisible);
     connect(gridCheckBox, &CheckBoxHidable::SetChecked, nBetweenInput, &QWidget::setVisible);
+    connect(gridCheckBox, &CheckBoxHidable::SetChecked, adaptiveCheckBox, &QWidget::setVisible);
+    connect(gridCheckBox, &CheckBoxHidable::SetChecked, lowRankCheckBox, &QWidget::setVisible);
+    connect(gridCheckBox, &CheckBoxHidable::SetChecked, treecodeCheckBox, &QWidget::setVisible);
     nLeftInput->setVisible(gridCheckBox->IsChecked());
     nRightInput->setVisible(gridCheckBox->IsChecked());
     nBottomInput->setVisible(gridCheckBox->IsChecked());
@@ -277,6 +327,9 @@ MainWindow::MainWindow(QWidget *parent)
     nzBottomInput->setVisible(gridCheckBox->IsChecked());
     nzTopInput->setVisible(gridCheckBox->IsChecked());
     nBetweenInput->setVisible(gridCheckBox->IsChecked());
+    adaptiveCheckBox->setVisible(gridCheckBox->IsChecked());
+    lowRankCheckBox->setVisible(gridCheckBox->IsChecked());
+    treecodeCheckBox->setVisible(gridCheckBox->IsChecked());
 
 }
 
@@ -286,6 +339,40 @@ MainWindow::~MainWindow()
 }
 
 void MainWindow::setupWellController()
+{
+    SetControllerInputs();
+    PQTView* snd = qobject_cast<PQTView*>(sender());
+    qDebug() << "sender OK";
+    if (snd == wellSchedView)
+        emit RunPQCalc();
+    else if (snd == gridSchedView)
+        emit RunGridCalc();
+    else
+        qDebug() << "MainWindow::setupWellController(): unknown sender";
+
+}
+
+void MainWindow::MatchHistory()
+{
+    SetControllerInputs();
+    try {
+        wellController->MatchHistory(wellSchedView->GetTValues(), wellSchedView->GetPValues(), wellSchedView->GetQValues());
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, "History match", e.what());
+    }
+}
+
+void MainWindow::Deconvolve()
+{
+    SetControllerInputs();
+    try {
+        wellController->Deconvolve();
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, "Deconvolution", e.what());
+    }
+}
+
+void MainWindow::SetControllerInputs()
 {
     wellController->setXe(xeInput->CurrentText());
     qDebug() << "setXe OK";
@@ -296,6 +383,7 @@ void MainWindow::setupWellController()
     wellController->setZw(zwInput->CurrentText());
     wellController->setRe(reInput->CurrentText());
     wellController->setRw(rwInput->CurrentText());
+    wellController->setSkin(skinInput->CurrentText());
     wellController->setFcd(fcdInput->CurrentText());
     wellController->setXf(xfInput->CurrentText());
     wellController->setLh(lhInput->CurrentText());
@@ -316,6 +404,8 @@ void MainWindow::setupWellController()
     wellController->setCalcmode(regimeInput->CurrentText());
     qDebug() << "setCalc mode OK";
     wellController->setTimeSchedule(wellSchedView->GetTValues());
+    wellController->setRateSchedule(wellSchedView->GetTValues(), wellSchedView->GetQValues());
+    wellController->setPressureHistory(wellSchedView->GetTValues(), wellSchedView->GetPValues());
     qDebug() << "setTimeSchedule OK";
     wellController->setTimeShcheduleGrid(gridSchedView->GetTValues());
     qDebug() << "setTimeShcheduleGrid OK";
@@ -327,16 +417,11 @@ void MainWindow::setupWellController()
     wellController->setNzBottom(nzBottomInput->CurrentText(), nzBottomInput->ComboText());
     wellController->setNzTop(nzTopInput->CurrentText(), nzTopInput->ComboText());
     wellController->setNBetween(nBetweenInput->CurrentText(), nBetweenInput->ComboText());
+    wellController->setAdaptiveGrid(adaptiveCheckBox->IsChecked());
+    wellController->setLowRankGrid(lowRankCheckBox->IsChecked());
+    wellController->setTreecodeGrid(treecodeCheckBox->IsChecked());
+    wellController->setSurrogate(surrogateCheckBox->IsChecked());
     qDebug() << "setNBetween OK";
-    PQTView* snd = qobject_cast<PQTView*>(sender());
-    qDebug() << "sender OK";
-    if (snd == wellSchedView)
-        emit RunPQCalc();
-    else if (snd == gridSchedView)
-        emit RunGridCalc();
-    else
-        qDebug() << "MainWindow::setupWellController(): unknown sender";
-
 }
 
 void MainWindow::AlignLineInputs(QVBoxLayout *vLayout)
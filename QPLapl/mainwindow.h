@@ -7,6 +7,7 @@
 #include <QStandardItemModel>
 #include <QSpacerItem>
 #include <QFileDialog>
+#include <QMessageBox>
 #include <QTextStream>
 #include "picmanager.h"
 #include "noteditabledelegate.h"
@@ -60,6 +61,7 @@ private:
     TextLineInput *lhInput;
     TextLineInput *nfracInput;
     TextLineInput *rwInput;
+    TextLineInput *skinInput;
     ComboLineinput *areashapeInput;
     TextLineInput *xeInput;
     TextLineInput *yeInput;
@@ -75,6 +77,8 @@ private:
 
     PQTView *wellSchedView;
     PQTView *gridSchedView;
+    QPushButton *matchButton;
+    QPushButton *deconvButton;
 
     TextComboLineInput *nLeftInput;
     TextComboLineInput *nRightInput;
@@ -86,9 +90,16 @@ private:
     TextComboLineInput *nBetweenInput;
     // check box
     CheckBoxHidable *gridCheckBox;
+    CheckBoxHidable *adaptiveCheckBox;
+    CheckBoxHidable *lowRankCheckBox;
+    CheckBoxHidable *treecodeCheckBox;
+    CheckBoxHidable *surrogateCheckBox;
     void AlignLineInputs(QVBoxLayout *vLayout);
+    void SetControllerInputs();
 private slots:
     void setupWellController();
+    void MatchHistory(); // of the well schedule table, the matched parameters replace the inputs
+    void Deconvolve(); // of the well schedule table, plotted over the model at the constant rate
     //test functions
     void CatchComboSendText(const QString& t) {
         qDebug() << "CatchComboSendText: " << t;
@@ -79,6 +79,16 @@ Matrix3DV::Matrix3DV(const Matrix3DV &other):
 {
 }
 
+Matrix3DV& Matrix3DV::operator=(const Matrix3DV &other)
+{
+    nx = other.nx;
+    ny = other.ny;
+    nz = other.nz;
+    n = nx*ny*nz;
+    data = other.data;
+    return *this;
+}
+
 Matrix3DV::Matrix3DV(): nx(0), ny(0), nz(0), n(0), data(0) {};
 
 void Matrix3DV::Update() {
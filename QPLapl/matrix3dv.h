@@ -62,6 +62,7 @@ public:
     Matrix3DV(size_t nx, size_t ny, size_t nz = 1);
     Matrix3DV(size_t nx, size_t ny, size_t nz, double val);
     Matrix3DV(const Matrix3DV& other);
+    Matrix3DV& operator=(const Matrix3DV& other);
     Matrix3DV();
     Matrix3DV(const std::string& filename);
     void UnsafeResize(size_t nx, size_t ny, size_t nz);
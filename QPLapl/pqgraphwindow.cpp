@@ -9,6 +9,9 @@ PQGraphWindow::PQGraphWindow(QWidget *parent) :
     QDialog(parent),
     ui(new Ui::PQGraphWindow),
     series(new QLineSeries()),
+    derivSeries(new QLineSeries()),
+    deconvSeries(new QLineSeries()),
+    deconvDerivSeries(new QLineSeries()),
     chart(new QChart()),
     chartView(new QChartView(chart)),
     xLinAxis(new QValueAxis(this)),
@@ -27,8 +30,9 @@ PQGraphWindow::PQGraphWindow(QWidget *parent) :
     connect(ui->checkBoxXLog, &QCheckBox::stateChanged, this, &PQGraphWindow::onXStateChanged);
     connect(ui->checkBoxYLog, &QCheckBox::stateChanged, this, &PQGraphWindow::onYStateChanged);
     connect(this, &PQGraphWindow::AxisUpdated, this, &PQGraphWindow::UpdateChart);
-    onXStateChanged(Qt::Unchecked);
-    onYStateChanged(Qt::Unchecked);
+    // log-log by default, the Bourdet derivative is read on it, the user may switch it off afterwards
+    ui->checkBoxXLog->setChecked(true);
+    ui->checkBoxYLog->setChecked(true);
     connect(ui->pushSave, &QPushButton::released, this, &PQGraphWindow::SaveData);
     connect(ui->pushClose, &QPushButton::released, this, &PQGraphWindow::close);
 }
@@ -50,7 +54,7 @@ void PQGraphWindow::setYLinAxis(QtCharts::QLineSeries*) {
     yLinAxis->setTitleText("Pressure");
     yLinAxis->setLabelFormat("%g");
     yLinAxis->setTickCount(series->count());
-    yLinAxis->setMax(series->at(0).y()*1.1);
+    yLinAxis->setMax(MaxY()*1.1);
     qDebug() << "PQGraphWindow::setYLinAxis OK";
     emit AxisUpdated();
 }
@@ -68,7 +72,7 @@ void PQGraphWindow::setYLogAxis(QtCharts::QLineSeries*) {
     yLogAxis->setLabelFormat("%g");
     yLogAxis->setBase(10.0);
     yLogAxis->setMinorTickCount(-1);
-    yLogAxis->setMax(series->at(0).y()*1.1);
+    yLogAxis->setMax(MaxY()*1.1);
     qDebug() << "PQGraphWindow::setYLogAxis OK";
     emit AxisUpdated();
 }
@@ -122,8 +126,68 @@ void PQGraphWindow::FillData(const QVector<DataPoint>& datapoints) {
     emit DataFilled(series);
 }
 
+void PQGraphWindow::FillDerivative(const QVector<DataPoint>& datapoints) {
+    // Bourdet derivative is shown on log-log axes, non-positive values can not be drawn there
+    double ymin = 0., ymax = 0.;
+    FillPositive(derivSeries, datapoints, ymin, ymax);
+    qDebug() << "Derivative series filled with " << derivSeries;
+    UpdateLegend();
+    if (derivSeries->count() == 0)
+        return;
+    yLogAxis->setMin(0.5*ymin);
+    if (1.1*ymax > yLogAxis->max())
+        yLogAxis->setMax(1.1*ymax);
+    emit AxisUpdated();
+}
+
+void PQGraphWindow::FillDeconvolution(const QVector<DataPoint>& pressure, const QVector<DataPoint>& derivative) {
+    // deconvolved pressure change and derivative over the model, kept until the next deconvolution
+    double ymin = 0., ymax = 0.;
+    FillPositive(deconvSeries, pressure, ymin, ymax);
+    FillPositive(deconvDerivSeries, derivative, ymin, ymax);
+    qDebug() << "Deconvolution series filled with " << deconvSeries;
+    UpdateLegend();
+    if (ymin == 0.)
+        return;
+    yLogAxis->setMin(std::min(yLogAxis->min(), 0.5*ymin));
+    yLogAxis->setMax(std::max(yLogAxis->max(), 1.1*ymax));
+    emit AxisUpdated();
+}
+
+void PQGraphWindow::FillPositive(QLineSeries *s, const QVector<DataPoint>& datapoints, double& ymin, double& ymax) {
+    s->clear();
+    for (const auto& dp: datapoints) {
+        if (dp.first <= 0. || dp.second <= 0.)
+            continue;
+        s->append({dp.first, dp.second});
+        if (ymin == 0. || dp.second < ymin)
+            ymin = dp.second;
+        ymax = std::max(ymax, dp.second);
+    }
+}
+
+void PQGraphWindow::UpdateLegend() {
+    chart->legend()->setVisible(derivSeries->count() > 0 || deconvSeries->count() > 0 || deconvDerivSeries->count() > 0);
+    series->setName(derivSeries->count() > 0 ? "Pressure change" : "Pressure");
+}
+
+double PQGraphWindow::MaxY() const {
+    // the pressure falls, but its change and the derivative rise, so the first point is not always the largest
+    double ans = series->at(0).y();
+    for (const auto& pt: series->points())
+        ans = std::max(ans, pt.y());
+    return ans;
+}
+
 void PQGraphWindow::CreateChart() {
     chart->addSeries(series);
+    series->setName("Pressure");
+    chart->addSeries(derivSeries);
+    derivSeries->setName("Derivative");
+    chart->addSeries(deconvSeries);
+    deconvSeries->setName("Deconvolved pressure change");
+    chart->addSeries(deconvDerivSeries);
+    deconvDerivSeries->setName("Deconvolved derivative");
     chart->legend()->hide();
     chart->setTitle("Logarithmic axis example");
     chartView->setRenderHint(QPainter::Antialiasing);
@@ -24,15 +24,22 @@ public:
     ~PQGraphWindow();
 public slots:
     void FillData(const QVector<DataPoint>&);
+    void FillDerivative(const QVector<DataPoint>&);
+    void FillDeconvolution(const QVector<DataPoint>& pressure, const QVector<DataPoint>& derivative);
     void ShowGraph();
 private:
     Ui::PQGraphWindow *ui;
     QtCharts::QLineSeries *series;
+    QtCharts::QLineSeries *derivSeries;
+    QtCharts::QLineSeries *deconvSeries, *deconvDerivSeries;
     QtCharts::QChart *chart;
     QtCharts::QChartView *chartView;
     QtCharts::QValueAxis *xLinAxis, *yLinAxis;
     QtCharts::QLogValueAxis *xLogAxis, *yLogAxis;
     void CreateChart();
+    double MaxY() const; // of series
+    void FillPositive(QtCharts::QLineSeries *s, const QVector<DataPoint>&, double& ymin, double& ymax); // ymin stays 0 if none
+    void UpdateLegend();
 
 signals:
     void DataFilled(QtCharts::QLineSeries*);
@@ -0,0 +1,210 @@
+#include "profiler.h"
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static const char* PROF_NAMES[PROF_KERNELS] = {
+    "InverseLaplace", "Pwd", "Solve", "FillIf2e", "VectI1f2h", "VectI1f2hYd", "ImageBlock", "LowRank", "Treecode",
+    "Ik0abPower", "Ik0abChebyshev", "Ik0abGauss"
+};
+
+KernelStats& KernelStats::operator+=(const KernelStats& other) {
+    calls += other.calls;
+    ns += other.ns;
+    terms += other.terms;
+    evals += other.evals;
+    hits += other.hits;
+    return *this;
+}
+
+const KernelStats& ProfileReport::operator[](const ProfKernel k) const {
+    return kernels[static_cast<int>(k)];
+}
+
+std::string ProfileReport::ToString() const {
+    ostringstream os;
+    os << "Kernel profile, threads: " << threads << "\n";
+    os << left << setw(16) << "kernel" << right << setw(12) << "calls" << setw(12) << "ms"
+       << setw(12) << "us/call" << setw(12) << "terms/call" << setw(12) << "evals/call" << setw(12) << "hits" << "\n";
+    os << fixed;
+    for (int i = 0; i < PROF_KERNELS; ++i) {
+        const KernelStats& s = kernels[i];
+        if (s.calls == 0 && s.hits == 0) continue;
+        double calls = s.calls > 0 ? static_cast<double>(s.calls) : 1.;
+        os << left << setw(16) << PROF_NAMES[i] << right << setw(12) << s.calls
+           << setprecision(1) << setw(12) << 1e-6*s.ns << setw(12) << 1e-3*s.ns/calls
+           << setw(12) << s.terms/calls << setw(12) << s.evals/calls << setw(12) << s.hits << "\n";
+    }
+    return os.str();
+}
+
+namespace {
+
+typedef array<KernelStats, PROF_KERNELS> Stats;
+
+struct Block;
+
+struct Registry {
+    mutex mtx;
+    set<Block*> live; // blocks of running threads
+    Stats retired; // sum of the blocks of finished threads
+    int retired_threads = 0;
+    vector<TraceEvent> retired_events;
+    int next_tid = 0;
+    atomic<bool> tracing{false};
+    const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+bool Used(const Stats& stats) {
+    for (auto& s: stats)
+        if (s.calls > 0 || s.hits > 0) return true;
+    return false;
+}
+
+struct Block {
+    Stats stats;
+    vector<TraceEvent> events;
+    int tid;
+    Block() {
+        Registry& reg = GetRegistry();
+        lock_guard<mutex> lock(reg.mtx);
+        tid = reg.next_tid++;
+        reg.live.insert(this);
+    }
+    ~Block() {
+        Registry& reg = GetRegistry();
+        lock_guard<mutex> lock(reg.mtx);
+        if (Used(stats)) {
+            for (int i = 0; i < PROF_KERNELS; ++i)
+                reg.retired[i] += stats[i];
+            ++reg.retired_threads;
+        }
+        reg.retired_events.insert(reg.retired_events.end(), events.begin(), events.end());
+        reg.live.erase(this);
+    }
+};
+
+Block& LocalBlock() {
+    thread_local Block block;
+    return block;
+}
+
+double Microseconds(const chrono::steady_clock::time_point t) {
+    return chrono::duration<double, micro>(t - GetRegistry().origin).count();
+}
+
+}
+
+KernelStats& Profiler::Local(const ProfKernel k) {
+    return LocalBlock().stats[static_cast<int>(k)];
+}
+
+void Profiler::Reset() {
+    Registry& reg = GetRegistry();
+    lock_guard<mutex> lock(reg.mtx);
+    reg.retired.fill(KernelStats());
+    reg.retired_threads = 0;
+    for (auto block: reg.live)
+        block->stats.fill(KernelStats());
+}
+
+ProfileReport Profiler::Collect() {
+    Registry& reg = GetRegistry();
+    lock_guard<mutex> lock(reg.mtx);
+    ProfileReport report;
+    report.kernels = reg.retired;
+    report.threads = reg.retired_threads;
+    for (auto block: reg.live) {
+        if (!Used(block->stats)) continue;
+        for (int i = 0; i < PROF_KERNELS; ++i)
+            report.kernels[i] += block->stats[i];
+        ++report.threads;
+    }
+    return report;
+}
+
+const char* Profiler::Name(const ProfKernel k) {
+    return PROF_NAMES[static_cast<int>(k)];
+}
+
+ProfileScope::ProfileScope(const ProfKernel k): stats(Profiler::Local(k)), start(chrono::steady_clock::now()) {
+    ++stats.calls;
+}
+
+ProfileScope::~ProfileScope() {
+    stats.ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void Trace::Start() {
+    Registry& reg = GetRegistry();
+    lock_guard<mutex> lock(reg.mtx);
+    reg.retired_events.clear();
+    for (auto block: reg.live)
+        block->events.clear();
+    reg.tracing = true;
+}
+
+void Trace::Stop() {
+    GetRegistry().tracing = false;
+}
+
+bool Trace::On() {
+    return GetRegistry().tracing.load(memory_order_relaxed);
+}
+
+std::size_t Trace::Write(std::ostream& os) {
+    Registry& reg = GetRegistry();
+    lock_guard<mutex> lock(reg.mtx);
+    vector<const TraceEvent*> events;
+    for (auto& e: reg.retired_events)
+        events.push_back(&e);
+    for (auto block: reg.live)
+        for (auto& e: block->events)
+            events.push_back(&e);
+    set<int> tids;
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    os << setprecision(15);
+    bool first = true;
+    for (auto e: events) {
+        os << (first ? "" : ",\n") << "{\"name\": \"" << e->name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e->tid
+           << ", \"ts\": " << e->ts << ", \"dur\": " << e->dur;
+        if (e->arg_name)
+            os << ", \"args\": {\"" << e->arg_name << "\": " << e->arg << "}";
+        os << "}";
+        first = false;
+        tids.insert(e->tid);
+    }
+    for (int tid: tids) {
+        os << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+           << ", \"args\": {\"name\": \"thread " << tid << "\"}}";
+        first = false;
+    }
+    os << "\n]}\n";
+    return events.size();
+}
+
+TraceScope::TraceScope(const char* name, const char* arg_name, const double arg): on(Trace::On()) {
+    if (!on) return;
+    event.name = name;
+    event.arg_name = arg_name;
+    event.arg = arg;
+    event.ts = Microseconds(chrono::steady_clock::now());
+}
+
+TraceScope::~TraceScope() {
+    if (!on) return;
+    Block& block = LocalBlock();
+    event.dur = Microseconds(chrono::steady_clock::now()) - event.ts;
+    event.tid = block.tid;
+    block.events.push_back(event);
+}
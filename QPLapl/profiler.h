@@ -0,0 +1,107 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+// Counters of the hot kernels of the numerical core and a timeline of its tasks, compiled in with
+// DEFINES += QPLAPL_PROFILE, otherwise PROFILE_SCOPE, PROFILE_COUNT and TRACE_SCOPE expand to nothing.
+// Every thread fills its own block without locks and adds it to the process totals when it ends,
+// so Profiler::Collect and Trace::Write give the whole calculation once its worker threads are joined
+
+enum class ProfKernel {
+    InverseLaplace, // Stehfest sums, evals are the transforms taken
+    Pwd, // LaplWell::pwd, hits are the td served by an asymptote here and in pwd_and_derivative
+    Solve, // QR of the segment system
+    FillIf2e, // cosine series of the matrix, terms are its k
+    VectI1f2h, // K0 x-images on the fracture line, terms are their k
+    VectI1f2hYd, // K0 x-images off the fracture line, terms are their k, evals are the qromb integrand calls
+    ImageBlock, // x-image blocks of MultiFractured, hits are the pairs that share a block of the same distance
+    LowRank, // far clusters of the low-rank grid evaluation, terms are their ranks, evals their points, hits the points not compressed
+    Treecode, // K0 image trees of the grid evaluation, terms are their sources, evals their points
+    Ik0abPower, // branches of Bess::ik0ab, calls only, the mixed one counts in both
+    Ik0abChebyshev,
+    Ik0abGauss,
+    Count
+};
+
+static const int PROF_KERNELS = static_cast<int>(ProfKernel::Count);
+
+struct KernelStats {
+    std::uint64_t calls = 0;
+    std::uint64_t ns = 0; // includes the nested kernels
+    std::uint64_t terms = 0;
+    std::uint64_t evals = 0;
+    std::uint64_t hits = 0;
+    KernelStats& operator+=(const KernelStats& other);
+};
+
+struct ProfileReport {
+    std::array<KernelStats, PROF_KERNELS> kernels;
+    int threads = 0; // threads that have recorded anything
+    const KernelStats& operator[](const ProfKernel k) const;
+    std::string ToString() const;
+};
+
+class Profiler {
+public:
+    static KernelStats& Local(const ProfKernel k); // counters of the calling thread
+    static void Reset(); // with no worker threads running
+    static ProfileReport Collect(); // the same
+    static const char* Name(const ProfKernel k);
+};
+
+class ProfileScope {
+    // a call and its time
+public:
+    explicit ProfileScope(const ProfKernel k);
+    ~ProfileScope();
+private:
+    KernelStats& stats;
+    const std::chrono::steady_clock::time_point start;
+};
+
+struct TraceEvent {
+    const char* name;
+    const char* arg_name; // nullptr if there is no argument
+    double arg;
+    double ts, dur; // microseconds from the start of the process
+    int tid;
+};
+
+class Trace {
+    // events of TRACE_SCOPE between Start and Stop, written in the Chrome trace event format
+    // (chrome://tracing, ui.perfetto.dev), one row per thread
+public:
+    static void Start(); // drops the events recorded before
+    static void Stop();
+    static bool On();
+    static std::size_t Write(std::ostream& os); // with no worker threads running, returns the number of events
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* arg_name = nullptr, const double arg = 0.);
+    ~TraceScope();
+private:
+    TraceEvent event;
+    const bool on;
+};
+
+#ifdef QPLAPL_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(kernel) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(kernel)
+#define PROFILE_COUNT(kernel, field, n) (Profiler::Local(kernel).field += (n))
+#define TRACE_SCOPE(...) TraceScope PROFILE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+#else
+// expressions, so that a disabled macro still makes a statement: "if (c) PROFILE_COUNT(...);" has a body
+#define PROFILE_SCOPE(kernel) ((void)0)
+#define PROFILE_COUNT(kernel, field, n) ((void)0)
+#define TRACE_SCOPE(...) ((void)0)
+#endif
+
+#endif // PROFILER_H
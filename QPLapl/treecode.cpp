@@ -0,0 +1,230 @@
+#include "treecode.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "qgaus.h"
+#include "quadrature.h"
+
+using namespace std;
+
+static const double TREE_INT_EPS = 1e-12; // of the direct integrals
+static const double TREE_GAUSS_DIST = 4.; // a segment farther than that many lengths is integrated by Gauss-Legendre
+
+namespace {
+
+const GaussIntegrator& SegmentGauss() {
+    static const GaussIntegrator gauss(TREE_NODES);
+    return gauss;
+}
+
+}
+
+K0Treecode::K0Treecode(const FastBessel::Bess& bess, const double k, std::vector<LineSource> sources,
+        const double eps, const double theta):
+        bess(bess), k(k), eps(eps), theta(theta), log_eps(log(eps)), sources(std::move(sources)) {
+    if (!(k > 0.)) throw invalid_argument("K0Treecode: k must be positive\n");
+    if (!(eps > 0. && eps < 1.) || !(theta > 0. && theta < 1.))
+        throw invalid_argument("K0Treecode: eps and theta must be in (0, 1)\n");
+    for (const auto& s: this->sources)
+        if (!(s.x2 > s.x1)) throw invalid_argument("K0Treecode: empty segment\n");
+    if (!this->sources.empty()) {
+        nodes.reserve(4*this->sources.size()/TREE_LEAF + 1);
+        Build(0, this->sources.size());
+    }
+}
+
+size_t K0Treecode::Size() const {
+    return sources.size();
+}
+
+size_t K0Treecode::Nodes() const {
+    return nodes.size();
+}
+
+int K0Treecode::Build(const size_t begin, const size_t end) {
+    double xmin = sources[begin].x1, xmax = sources[begin].x2, ymin = sources[begin].y, ymax = ymin;
+    for (size_t i = begin; i < end; ++i) {
+        xmin = min(xmin, sources[i].x1);
+        xmax = max(xmax, sources[i].x2);
+        ymin = min(ymin, sources[i].y);
+        ymax = max(ymax, sources[i].y);
+    }
+    int index = nodes.size();
+    nodes.push_back(Node());
+    Node node;
+    node.cx = 0.5*(xmin + xmax);
+    node.cy = 0.5*(ymin + ymax);
+    node.begin = begin;
+    node.end = end;
+    node.child[0] = node.child[1] = -1;
+    node.moments.assign(TREE_MAX_ORDER + 1, 0.);
+    if (end - begin <= static_cast<size_t>(TREE_LEAF)) {
+        node.radius = 0.;
+        for (size_t i = begin; i < end; ++i) {
+            double dy = sources[i].y - node.cy;
+            node.radius = max(node.radius, hypot(max(abs(sources[i].x1 - node.cx), abs(sources[i].x2 - node.cx)), dy));
+        }
+        LeafMoments(node);
+    } else {
+        // halves by the segment centers along the longer side of the box
+        const bool by_x = xmax - xmin >= ymax - ymin;
+        size_t mid = begin + (end - begin)/2;
+        nth_element(sources.begin() + begin, sources.begin() + mid, sources.begin() + end,
+                [by_x](const LineSource& a, const LineSource& b) {
+                    return by_x ? a.x1 + a.x2 < b.x1 + b.x2 : a.y < b.y;
+                });
+        node.child[0] = Build(begin, mid);
+        node.child[1] = Build(mid, end);
+        // the radius bounds the children, so the shifted moments are scaled down
+        node.radius = 0.;
+        for (int c: node.child)
+            node.radius = max(node.radius, hypot(nodes[c].cx - node.cx, nodes[c].cy - node.cy) + nodes[c].radius);
+        for (int c: node.child)
+            ShiftMoments(nodes[c], node);
+    }
+    nodes[index] = std::move(node);
+    return index;
+}
+
+void K0Treecode::LeafMoments(Node& node) const {
+    const GaussIntegrator& gauss = SegmentGauss();
+    vector<double> in(TREE_MAX_ORDER + 1);
+    for (size_t i = node.begin; i < node.end; ++i) {
+        const LineSource& s = sources[i];
+        double xm = 0.5*(s.x1 + s.x2), xr = 0.5*(s.x2 - s.x1);
+        for (int g = 0; g < gauss.n; ++g) {
+            double w = s.w*xr*gauss.w[g];
+            double dx = xm + xr*gauss.x[g] - node.cx, dy = s.y - node.cy;
+            double rho = hypot(dx, dy);
+            ScaledI(k*rho, TREE_MAX_ORDER, in);
+            complex<double> e = rho > 0. ? complex<double>(dx, -dy)/rho : complex<double>(1., 0.), en = 1.;
+            double mult = w*exp(k*(rho - node.radius));
+            for (int n = 0; n <= TREE_MAX_ORDER; ++n) {
+                node.moments[n] += mult*in[n]*en;
+                en *= e;
+            }
+        }
+    }
+}
+
+void K0Treecode::ShiftMoments(const Node& from, Node& to) const {
+    // I_n(k|a + d|)exp(-i*n*arg(a + d)) = sum_m I_{n-m}(k|d|)exp(-i*(n-m)*arg d)*I_m(k|a|)exp(-i*m*arg a),
+    // d from the parent center to the child one, the child moments of negative m are conjugate
+    const int p = TREE_MAX_ORDER;
+    double dx = from.cx - to.cx, dy = from.cy - to.cy;
+    double d = hypot(dx, dy);
+    vector<double> in(2*p + 1);
+    ScaledI(k*d, 2*p, in);
+    complex<double> e = d > 0. ? complex<double>(dx, -dy)/d : complex<double>(1., 0.);
+    vector<complex<double>> shift(2*p + 1); // I_j(k*d)*exp(-i*j*arg d), j = -2p..2p, stored at j + 2p for j >= 0 only
+    complex<double> en = 1.;
+    for (int j = 0; j <= 2*p; ++j) {
+        shift[j] = in[j]*en;
+        en *= e;
+    }
+    // I_{-j} = I_j and exp(i*j*arg d) = conj, so the shift of -j is conj(shift[j])
+    const double mult = exp(k*(d + from.radius - to.radius));
+    for (int n = 0; n <= p; ++n) {
+        complex<double> sum = 0.;
+        for (int m = -p; m <= p; ++m) {
+            complex<double> mm = m >= 0 ? from.moments[m] : conj(from.moments[-m]);
+            int j = n - m;
+            sum += (j >= 0 ? shift[j] : conj(shift[-j]))*mm;
+        }
+        to.moments[n] += mult*sum;
+    }
+}
+
+double K0Treecode::operator()(const double x, const double y) const {
+    if (nodes.empty()) return 0.;
+    vector<double> kn(TREE_MAX_ORDER + 1);
+    double ans = 0.;
+    vector<int> stack = {0};
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        double dx = x - node.cx, dy = y - node.cy;
+        double r = hypot(dx, dy);
+        if (node.radius < theta*r) {
+            // I_n(k*rho) falls faster than exponentially past n ~ e*k*R/2, the terms after that as (R/r)^n
+            int order = static_cast<int>(ceil(log_eps/log(node.radius/r))) + static_cast<int>(ceil(3.*k*node.radius));
+            if (node.radius == 0.) order = 0;
+            if (order <= TREE_MAX_ORDER) {
+                double decay = exp(-k*(r - node.radius));
+                if (decay == 0.) continue;
+                ScaledK(k*r, order, kn);
+                complex<double> e = complex<double>(dx, dy)/r, en = e;
+                double sum = kn[0]*node.moments[0].real();
+                for (int n = 1; n <= order; ++n) {
+                    sum += 2.*kn[n]*(node.moments[n]*en).real();
+                    en *= e;
+                }
+                ans += decay*sum;
+                continue;
+            }
+        }
+        if (node.child[0] < 0) {
+            for (size_t i = node.begin; i < node.end; ++i)
+                ans += sources[i].w*Direct(sources[i], x, y);
+        } else {
+            stack.push_back(node.child[0]);
+            stack.push_back(node.child[1]);
+        }
+    }
+    return ans;
+}
+
+double K0Treecode::Direct(const LineSource& s, const double x, const double y) const {
+    const double ady = abs(y - s.y);
+    const double t1 = s.x1 - x, t2 = s.x2 - x;
+    if (ady < 1e-16)
+        return bess.abs_ik0ab(k*t1, k*t2)/k;
+    auto func = [this, ady](double t) {return this->bess.k0(this->k*sqrt(t*t + ady*ady));};
+    const double len = t2 - t1;
+    if (hypot(0.5*(t1 + t2), ady) > TREE_GAUSS_DIST*len)
+        return SegmentGauss().Integrate(func, t1, t2);
+    // the integrand is even in t, split at zero when the segment is under the point
+    if (t1 < 0. && t2 > 0.) return qromb(func, 0., -t1, TREE_INT_EPS) + qromb(func, 0., t2, TREE_INT_EPS);
+    return qromb(func, min(abs(t1), abs(t2)), max(abs(t1), abs(t2)), TREE_INT_EPS);
+}
+
+void K0Treecode::ScaledI(const double x, const int nmax, std::vector<double>& ans) const {
+    // Miller's downward recurrence I_{j-1} = I_{j+1} + 2j/x*I_j normalized by exp(-x)*I_0 (Numerical Recipes bessi),
+    // started above both nmax and x
+    ans.assign(nmax + 1, 0.);
+    if (x < 1e-100) { // I_n(x) for n > 0 underflows anyway
+        ans[0] = 1.;
+        return;
+    }
+    // the rescale is by the value itself, at small x one step grows it by 2j/x and a fixed factor would not keep up
+    const double BIGNO = 1e10;
+    const int top = max(nmax, static_cast<int>(x));
+    const int m = 2*(top + static_cast<int>(sqrt(40.*top)));
+    double bip = 0., bi = 1., bim;
+    for (int j = m; j > 0; --j) {
+        bim = bip + 2.*j/x*bi;
+        bip = bi;
+        bi = bim;
+        if (abs(bi) > BIGNO) {
+            const double scale = 1./bi;
+            bi = 1.;
+            bip *= scale;
+            for (int n = j; n <= nmax; ++n)
+                ans[n] *= scale;
+        }
+        if (j <= nmax) ans[j] = bip;
+    }
+    const double norm = bess.i0e(x)/bi;
+    ans[0] = bess.i0e(x);
+    for (int n = 1; n <= nmax; ++n)
+        ans[n] *= norm;
+}
+
+void K0Treecode::ScaledK(const double x, const int nmax, std::vector<double>& ans) const {
+    // upward recurrence K_{n+1} = K_{n-1} + 2n/x*K_n, stable for K
+    ans[0] = bess.k0e(x);
+    if (nmax == 0) return;
+    ans[1] = bess.k1e(x);
+    for (int n = 1; n < nmax; ++n)
+        ans[n+1] = ans[n-1] + 2.*n/x*ans[n];
+}
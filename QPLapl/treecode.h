@@ -0,0 +1,53 @@
+#ifndef TREECODE_H
+#define TREECODE_H
+
+#include <vector>
+#include <complex>
+#include "chbessel.h"
+
+static const double TREE_EPS = 1e-10; // relative error of a multipole expansion against its cluster
+static const double TREE_THETA = 0.5; // a cluster is expanded when its radius is less than TREE_THETA of the distance
+static const int TREE_LEAF = 16; // sources of a leaf
+static const int TREE_MAX_ORDER = 64; // of the moments, a cluster that needs more is opened
+static const int TREE_NODES = 8; // Gauss-Legendre nodes of a segment in the moments
+
+struct LineSource {
+    // uniform density w on [x1, x2] along x at y
+    double x1, x2, y, w;
+};
+
+class K0Treecode {
+    // sum_j w_j*int_{x1_j}^{x2_j} K0(k*|p - (s, y_j)|)ds at points p, Barnes-Hut style. A cluster of sources with
+    // center c and radius R far enough from p goes by its moments M_n = sum_j w_j*int I_n(k*rho)*exp(-i*n*phi)ds,
+    // (rho, phi) of the source point around c, through the addition theorem
+    // K0(k*|p - q|) = sum_n K_n(k*r)*I_n(k*rho)*exp(i*n*(theta - phi)), (r, theta) of p around c, rho < r.
+    // The moments of a leaf come from its segments, those of a node from its children by the same theorem for I_n.
+    // The other sources are integrated directly. The order of an expansion grows with k*R, so at large k the
+    // clusters that would need more than TREE_MAX_ORDER terms are opened, their far field is negligible anyway
+public:
+    K0Treecode(const FastBessel::Bess& bess, const double k, std::vector<LineSource> sources,
+            const double eps = TREE_EPS, const double theta = TREE_THETA);
+    double operator()(const double x, const double y) const;
+    size_t Size() const; // sources
+    size_t Nodes() const;
+private:
+    struct Node {
+        double cx, cy, radius;
+        size_t begin, end; // sources of the node
+        int child[2]; // -1 for a leaf
+        std::vector<std::complex<double>> moments; // n = 0..TREE_MAX_ORDER, scaled by exp(-k*radius)
+    };
+    const FastBessel::Bess& bess;
+    const double k, eps, theta;
+    const double log_eps;
+    std::vector<LineSource> sources;
+    std::vector<Node> nodes;
+    int Build(const size_t begin, const size_t end); // index of the node
+    void LeafMoments(Node& node) const;
+    void ShiftMoments(const Node& from, Node& to) const; // adds the moments of a child to its parent
+    double Direct(const LineSource& s, const double x, const double y) const;
+    void ScaledI(const double x, const int nmax, std::vector<double>& ans) const; // exp(-x)*I_n(x), n = 0..nmax
+    void ScaledK(const double x, const int nmax, std::vector<double>& ans) const; // exp(x)*K_n(x), n = 0..nmax
+};
+
+#endif // TREECODE_H
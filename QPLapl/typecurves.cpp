@@ -0,0 +1,237 @@
+#include "typecurves.h"
+
+using namespace std;
+
+static const char TC_MAGIC[8] = {'Q', 'P', 'L', 'T', 'C', 'U', 'R', 'V'};
+
+namespace {
+
+vector<double> LogVector(const vector<double>& v) {
+    vector<double> ans(v.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i] <= 0.) throw invalid_argument("TypeCurveLibrary: lattice values must be positive\n");
+        ans[i] = log(v[i]);
+    }
+    return ans;
+}
+
+template <typename T>
+void WriteVector(ofstream& of, const vector<T>& v) {
+    uint32_t n = v.size();
+    of.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    of.write(reinterpret_cast<const char*>(v.data()), n*sizeof(T));
+}
+
+template <typename T>
+vector<T> ReadVector(ifstream& ifs) {
+    uint32_t n = 0;
+    ifs.read(reinterpret_cast<char*>(&n), sizeof(n));
+    vector<T> v(n);
+    ifs.read(reinterpret_cast<char*>(v.data()), n*sizeof(T));
+    if (!ifs) throw runtime_error("TypeCurveLibrary: unexpected end of file\n");
+    return v;
+}
+
+}
+
+TypeCurveLibrary::TypeCurveLibrary(const std::vector<double>& fcds, const std::vector<double>& xeds, const std::vector<double>& yeds,
+        const std::vector<double>& xwd_rels, const std::vector<double>& ywd_rels,
+        const std::vector<double>& tds):
+    axes({LogVector(fcds), LogVector(xeds), LogVector(yeds), xwd_rels, ywd_rels}), ltds(LogVector(tds)) {
+    for (const auto& a: axes)
+        if (a.empty()) throw invalid_argument("TypeCurveLibrary: empty lattice axis\n");
+    if (ltds.size() < 2) throw invalid_argument("TypeCurveLibrary: at least two td values are needed\n");
+};
+
+TypeCurveLibrary::TypeCurveLibrary(const std::string& filename) {
+    ifstream ifs(filename, ios::binary);
+    if (!ifs) throw runtime_error("TypeCurveLibrary: can not open " + filename + "\n");
+    char magic[8];
+    uint32_t version = 0, ndim = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!ifs || !equal(magic, magic + 8, TC_MAGIC) || version != TC_VERSION)
+        throw runtime_error("TypeCurveLibrary: " + filename + " is not a type curve file\n");
+    ifs.read(reinterpret_cast<char*>(&ndim), sizeof(ndim));
+    for (uint32_t k = 0; k < ndim; ++k)
+        axes.push_back(ReadVector<double>(ifs));
+    ltds = ReadVector<double>(ifs);
+    lpw = ReadVector<float>(ifs);
+    lqw = ReadVector<float>(ifs);
+    if (lpw.size() != NNodes()*ltds.size() || lqw.size() != lpw.size())
+        throw runtime_error("TypeCurveLibrary: corrupted table in " + filename + "\n");
+}
+
+void TypeCurveLibrary::Build(int nthreads) {
+    size_t nnodes = NNodes(), ntd = ltds.size();
+    for (size_t node = 0; node < nnodes; ++node) {
+        FractureParams p = NodeParams(node);
+        if (p.xwd < 1. || p.xed - p.xwd < 1. || p.ywd <= 0. || p.ywd >= p.yed)
+            throw invalid_argument("TypeCurveLibrary::Build: fracture crosses the drainage area boundary\n");
+    }
+    lpw.assign(nnodes*ntd, 0.f);
+    lqw.assign(nnodes*ntd, 0.f);
+    vector<size_t> nodes(nnodes);
+    for (size_t i = 0; i < nnodes; ++i) nodes[i] = i;
+    auto pages = NPaginate(nodes, nthreads);
+    vector<future<void>> futures;
+    for (auto& page: pages) {
+        futures.push_back(async(launch::async, [this, ntd](auto pg) {
+            for (size_t node: pg) {
+                FractureParams p = NodeParams(node);
+                Rectangular::Fracture well(Boundary::NNNN, p.xwd, p.xed, p.ywd, p.yed, p.Fcd);
+                for (size_t it = 0; it < ntd; ++it) {
+                    double td = exp(ltds[it]);
+                    lpw[node*ntd+it] = static_cast<float>(log(well.pwd_full(td)));
+                    lqw[node*ntd+it] = static_cast<float>(log(well.qwd(td)));
+                }
+            }
+        }, page));
+    }
+    for (auto& f: futures)
+        f.get();
+}
+
+void TypeCurveLibrary::Save(const std::string& filename) const {
+    if (lpw.empty()) throw logic_error("TypeCurveLibrary::Save: table is not built\n");
+    ofstream of(filename, ios::binary);
+    if (!of) throw runtime_error("TypeCurveLibrary: can not open " + filename + "\n");
+    uint32_t ndim = axes.size();
+    of.write(TC_MAGIC, sizeof(TC_MAGIC));
+    of.write(reinterpret_cast<const char*>(&TC_VERSION), sizeof(TC_VERSION));
+    of.write(reinterpret_cast<const char*>(&ndim), sizeof(ndim));
+    for (const auto& a: axes)
+        WriteVector(of, a);
+    WriteVector(of, ltds);
+    WriteVector(of, lpw);
+    WriteVector(of, lqw);
+}
+
+TypeCurve TypeCurveLibrary::pwd(const FractureParams& p, const std::vector<double>& tds, int nthreads, const double max_err) const {
+    TypeCurve ans;
+    if (LookupPwd(p, tds, ans, max_err)) return ans;
+    Rectangular::Fracture well(Boundary::NNNN, p.xwd, p.xed, p.ywd, p.yed, p.Fcd);
+    ans.vals.resize(tds.size());
+    well.pwd_parallel(tds, ans.vals, nthreads);
+    ans.err = 0.;
+    ans.exact = true;
+    return ans;
+}
+
+TypeCurve TypeCurveLibrary::qwd(const FractureParams& p, const std::vector<double>& tds, int nthreads, const double max_err) const {
+    TypeCurve ans;
+    if (LookupQwd(p, tds, ans, max_err)) return ans;
+    Rectangular::Fracture well(Boundary::NNNN, p.xwd, p.xed, p.ywd, p.yed, p.Fcd);
+    ans.vals.resize(tds.size());
+    well.qwd_parallel(tds, ans.vals, nthreads);
+    ans.err = 0.;
+    ans.exact = true;
+    return ans;
+}
+
+bool TypeCurveLibrary::LookupPwd(const FractureParams& p, const std::vector<double>& tds, TypeCurve& ans, const double max_err) const {
+    return Interpolate(lpw, p, tds, max_err, ans);
+}
+
+bool TypeCurveLibrary::LookupQwd(const FractureParams& p, const std::vector<double>& tds, TypeCurve& ans, const double max_err) const {
+    return Interpolate(lqw, p, tds, max_err, ans);
+}
+
+bool TypeCurveLibrary::Contains(const FractureParams& p) const {
+    Multilin_interp mi(axes);
+    return mi.inside(Coords(p));
+}
+
+size_t TypeCurveLibrary::NNodes() const {
+    size_t ans = 1;
+    for (const auto& a: axes)
+        ans *= a.size();
+    return ans;
+}
+
+std::vector<double> TypeCurveLibrary::Coords(const FractureParams& p) const {
+    return {log(p.Fcd), log(p.xed), log(p.yed), p.xwd/p.xed, p.ywd/p.yed};
+}
+
+FractureParams TypeCurveLibrary::NodeParams(size_t node) const {
+    vector<double> x(axes.size());
+    for (int k = axes.size() - 1; k >= 0; --k) {
+        x[k] = axes[k][node % axes[k].size()];
+        node /= axes[k].size();
+    }
+    FractureParams p;
+    p.Fcd = exp(x[0]);
+    p.xed = exp(x[1]);
+    p.yed = exp(x[2]);
+    p.xwd = x[3]*p.xed;
+    p.ywd = x[4]*p.yed;
+    return p;
+}
+
+bool TypeCurveLibrary::Interpolate(const std::vector<float>& table, const FractureParams& p, const std::vector<double>& tds,
+        const double max_err, TypeCurve& ans) const {
+    if (table.empty()) return false;
+    Multilin_interp mi(axes);
+    vector<size_t> nodes;
+    vector<double> w;
+    if (!mi.weights(Coords(p), nodes, w)) return false;
+    if (tds.empty()) return false;
+    double lmin = log(tds.front()), lmax = lmin;
+    for (double td: tds) {
+        lmin = min(lmin, log(td));
+        lmax = max(lmax, log(td));
+    }
+    if (!(lmin >= ltds.front() && lmax <= ltds.back())) return false;
+    size_t ntd = ltds.size();
+    // the lattice error counts at the tabulated td that the interpolation in log td takes for tds, two on each side
+    size_t it0 = upper_bound(ltds.begin(), ltds.end(), lmin) - ltds.begin();
+    size_t it1 = min(ntd, static_cast<size_t>(lower_bound(ltds.begin(), ltds.end(), lmax) - ltds.begin()) + 2);
+    it0 = it0 >= 2 ? it0 - 2 : 0;
+    vector<double> curve(ntd, 0.);
+    double err = 0.;
+    for (size_t it = 0; it < ntd; ++it) {
+        for (size_t i = 0; i < nodes.size(); ++i)
+            curve[it] += w[i]*table[nodes[i]*ntd+it];
+        if (it < it0 || it >= it1) continue;
+        double err_it = 0.;
+        for (int k = 0; k < mi.ndim; ++k)
+            err_it += AxisError(table, mi, nodes[0], k, it);
+        err = max(err, err_it);
+    }
+    // the lattice and the td errors add up
+    Poly_interp tdinterp(ltds, curve, min<int>(4, ntd));
+    ans.vals.resize(tds.size());
+    double err_td = 0.;
+    for (size_t i = 0; i < tds.size(); ++i) {
+        ans.vals[i] = exp(tdinterp.interp(log(tds[i])));
+        if (ntd > 2) err_td = max(err_td, abs(tdinterp.dy));
+    }
+    err += err_td;
+    if (err > max_err) return false;
+    ans.err = err;
+    ans.exact = false;
+    return true;
+}
+
+double TypeCurveLibrary::AxisError(const std::vector<float>& table, const Multilin_interp& mi, size_t base, int k, size_t it) const {
+    // error of linear interpolation along axis k estimated by the second divided difference
+    // of the tabulated log values: 0.5*t*(1-t)*h^2*|f''|, with the larger |f''| of the stencils
+    // centred at both ends of the bracket, as the curvature changes across it
+    const vector<double>& a = mi.axes[k];
+    size_t n = a.size();
+    if (n < 3) return 0.;
+    int j = mi.jlo[k];
+    size_t ntd = ltds.size();
+    double d2 = 0.;
+    for (int jc: {j, j + 1}) {
+        jc = min(max(jc, 1), static_cast<int>(n) - 2);
+        size_t node0 = base - j*mi.strides[k] + jc*mi.strides[k];
+        double fm = table[(node0 - mi.strides[k])*ntd+it];
+        double f0 = table[node0*ntd+it];
+        double fp = table[(node0 + mi.strides[k])*ntd+it];
+        double h0 = a[jc] - a[jc-1], h1 = a[jc+1] - a[jc];
+        d2 = max(d2, abs(2.*((fp - f0)/h1 - (f0 - fm)/h0)/(h0 + h1)));
+    }
+    double h = a[j+1] - a[j];
+    return 0.5*mi.t[k]*(1. - mi.t[k])*h*h*d2;
+}
@@ -0,0 +1,56 @@
+#ifndef TYPECURVES_H
+#define TYPECURVES_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <stdexcept>
+#include "gwell.h"
+#include "interp_1d.h"
+
+static const double TC_EPS = 1e-2; // max estimated relative interpolation error served from the table, plot accuracy
+static const uint32_t TC_VERSION = 1;
+
+struct FractureParams {
+    double Fcd, xed, yed, xwd, ywd;
+};
+
+struct TypeCurve {
+    std::vector<double> vals;
+    double err; // estimated max relative interpolation error, 0. for exact solutions
+    bool exact; // true if the curve was calculated by Rectangular::Fracture
+};
+
+class TypeCurveLibrary {
+    // Tabulated pwd(td) and qwd(td) of Rectangular::Fracture with NNNN boundaries on a lattice over
+    // Fcd, xed, yed and the relative well position xwd/xed, ywd/yed.
+    // Curves are interpolated multilinearly in (log Fcd, log xed, log yed, xwd/xed, ywd/yed) and by
+    // polynomial interpolation in log td; points outside the lattice or with a too large error estimate
+    // are calculated by the exact solver.
+public:
+    TypeCurveLibrary(const std::vector<double>& fcds, const std::vector<double>& xeds, const std::vector<double>& yeds,
+            const std::vector<double>& xwd_rels, const std::vector<double>& ywd_rels,
+            const std::vector<double>& tds);
+    explicit TypeCurveLibrary(const std::string& filename);
+    void Build(int nthreads); // offline: calculates every lattice node with the exact solver
+    void Save(const std::string& filename) const;
+    TypeCurve pwd(const FractureParams& p, const std::vector<double>& tds, int nthreads = 1, const double max_err = TC_EPS) const;
+    TypeCurve qwd(const FractureParams& p, const std::vector<double>& tds, int nthreads = 1, const double max_err = TC_EPS) const;
+    // the table alone, false where pwd and qwd would fall back to the exact solver
+    bool LookupPwd(const FractureParams& p, const std::vector<double>& tds, TypeCurve& ans, const double max_err = TC_EPS) const;
+    bool LookupQwd(const FractureParams& p, const std::vector<double>& tds, TypeCurve& ans, const double max_err = TC_EPS) const;
+    bool Contains(const FractureParams& p) const;
+    size_t NNodes() const;
+private:
+    std::vector<std::vector<double>> axes; // lattice axes in interpolation coordinates
+    std::vector<double> ltds; // log td of the tabulated points
+    std::vector<float> lpw, lqw; // log pwd and log qwd, ltds.size() values per lattice node
+    std::vector<double> Coords(const FractureParams& p) const;
+    FractureParams NodeParams(size_t node) const;
+    bool Interpolate(const std::vector<float>& table, const FractureParams& p, const std::vector<double>& tds,
+            const double max_err, TypeCurve& ans) const;
+    double AxisError(const std::vector<float>& table, const Multilin_interp& mi, size_t base, int k, size_t it) const;
+};
+
+#endif // TYPECURVES_H
@@ -1,75 +1,318 @@
 #include "wellcontroller.h"
 #include <QDebug>
+#include <QCoreApplication>
+#include <fstream>
+
+static const double TC_DLTD = 1e-2; // log td step of the derivative of a tabulated pwd
 
 WellController::WellController(QObject *parent) : QObject(parent)
 {
+    QString fname = QCoreApplication::applicationDirPath() + "/" + TypeCurvesFile;
+    if (QFile::exists(fname)) {
+        try {
+            setTypeCurves(fname);
+        } catch (const std::exception& e) {
+            qDebug() << "Type curves are not loaded:" << e.what();
+        }
+    }
 }
 
 std::unique_ptr<LaplWell> WellController::makeWell() const
 {
     CH_OPT(wellType);
     CH_OPT(areaShape);
+    std::unique_ptr<LaplWell> well;
     switch (*areaShape) {
     case DrainageArea::Rectangular:
         switch (*wellType) {
         case WellType::Fracture:
-            return std::make_unique<Rectangular::Fracture>(*boundaryConditions, xwd(), xed(), ywd(), yed(), fcd());
+            well = std::make_unique<Rectangular::Fracture>(*boundaryConditions, xwd(), xed(), ywd(), yed(), fcd());
+            break;
+        case WellType::MultiFractured: {
+            CH_OPT(nFrac);
+            CH_OPT(lh);
+            CH_OPT(mFracOrientation);
+            if (*mFracOrientation != MultifracOrientation::Normal)
+                throw std::logic_error("parallel orientation is not implemented\n");
+            // fractures normal to the horizontal wellbore, equally spaced along it
+            double lhd = *lh/lref();
+            std::vector<double> ywds(*nFrac, ywd());
+            for (int k = 0; k < *nFrac && *nFrac > 1; ++k)
+                ywds[k] = ywd() - lhd + 2.*lhd*k/(*nFrac-1);
+            well = std::make_unique<Rectangular::MultiFractured>(*boundaryConditions, xwd(), xed(), ywds, yed(), fcd());
+            break;
+        }
+        case WellType::Horizontal:
+            CH_OPT(rw);
+            CH_OPT(h);
+            // zwd() is the wellbore surface above the axis
+            well = std::make_unique<Rectangular::Horizontal>(*boundaryConditions, xwd(), xed(), ywd(), yed(),
+                    zwd() - (*rw)/(*h), hd(), (*rw)/(*h));
+            break;
+        case WellType::Vertical:
+            well = std::make_unique<Rectangular::Vertical>(*boundaryConditions, xwd(), xed(), ywd(), yed());
+            break;
+        default:
+            throw std::logic_error("not implemented well type\n");
+        }
+        break;
+    case DrainageArea::Infinite:
+        switch (*wellType) {
+        case WellType::Fracture:
+            well = std::make_unique<Infinite::Fracture>(fcd());
+            break;
         default:
             throw std::logic_error("not implemented well type\n");
         }
+        break;
+    case DrainageArea::Circle:
+        // the well is in the center, xd and yd are taken from it
+        switch (*wellType) {
+        case WellType::Fracture:
+            well = std::make_unique<Circular::Fracture>(*boundaryConditions, red(), fcd());
+            break;
+        case WellType::Vertical:
+            well = std::make_unique<Circular::Vertical>(*boundaryConditions, red());
+            break;
+        default:
+            throw std::logic_error("not implemented well type\n");
+        }
+        break;
     default:
         throw std::logic_error("not implemented area shape\n");
     }
+    well->SetLowRankTolerance(lowRankGrid ? LR_EPS : 0.);
+    well->SetTreecodeTolerance(treecodeGrid ? TREE_EPS : 0.);
+    if (skin && *skin != 0.)
+        well = std::make_unique<SkinWell>(std::move(well), *skin);
+    well->SetAsymptoteTolerance(ASYMPT_TOL);
+    return well;
+}
+
+bool WellController::EngineInputs::operator==(const EngineInputs& other) const
+{
+    return well == other.well && tds == other.tds && extra == other.extra;
+}
+
+WellController::EngineInputs WellController::makeEngineInputs(const std::vector<double>& tds,
+        const std::vector<std::vector<double>>& extra) const
+{
+    auto code = [](const auto& opt) {
+        return opt ? std::optional<double>(static_cast<int>(*opt)) : std::nullopt;
+    };
+    EngineInputs ans;
+    ans.well = {xe, xw, ye, yw, zw, re, rw, Fcd, xf, lh, h, skin,
+                code(nFrac), code(mFracOrientation), code(wellType), code(boundaryConditions), code(areaShape)};
+    ans.tds = tds;
+    ans.extra = extra;
+    return ans;
 }
 
 void WellController::CalculatePQ()
 {
     qDebug() << "Start CalculatePQ";
     CH_OPT(calcMode);
-    std::unique_ptr<LaplWell> well = makeWell();
-    qDebug() << "Make well OK";
+    Profiler::Reset();
     tds = ConvertT_Td(ts);
     qDebug() << "tds OK size " << tds;
+    std::vector<double> qdsSchedule; // relative to qWell, empty for the constant rate
+    if (*calcMode == CalcMode::ConstQ && isVariableRate()) {
+        if (*qWell == 0.)
+            throw std::logic_error("WellController::CalculatePQ: the well rate scales the rate schedule and can not be zero\n");
+        qdsSchedule = ConvertVector(qsSchedule, 1./(*qWell));
+    }
+    EngineInputs inputs = makeEngineInputs(tds, {qdsSchedule,
+            {static_cast<double>(static_cast<int>(*calcMode)), static_cast<double>(surrogate)}});
+    if (pqInputs && *pqInputs == inputs) {
+        qDebug() << "Dimensionless inputs are unchanged, the cached results are rescaled";
+    } else {
+        pqInputs.reset();
+        if (!lookupTypeCurves(qdsSchedule)) {
+            std::unique_ptr<LaplWell> well = makeWell();
+            qDebug() << "Make well OK";
+            if (surrogate && tds.size() > 1 && tds.front() > 0.) {
+                // the variable rate schedule takes lags down to the shortest time step
+                double tdMin = tds.front();
+                for (size_t i = 1; i < tds.size(); ++i)
+                    if (tds[i] > tds[i-1]) tdMin = std::min(tdMin, tds[i] - tds[i-1]);
+                auto sw = std::make_unique<SurrogateWell>(std::move(well), tdMin, tds.back(), 4);
+                qDebug() << "Surrogate of" << sw->Samples() << "transforms, error estimate" << sw->ErrorEstimate();
+                well = std::move(sw);
+            }
+            switch (*calcMode) {
+            case CalcMode::ConstQ:
+                pds.resize(tds.size());
+                if (!qdsSchedule.empty()) {
+                    well->pwd_schedule(tds, tds, qdsSchedule, pds, 4);
+                    dpds.clear();
+                } else {
+                    well->pwd_and_derivative(tds, pds, dpds, 4);
+                }
+                qDebug() << "pds OK " << pds;
+                break;
+            case CalcMode::ConstP:
+                qds.resize(tds.size());
+                well->qwd_parallel(tds, qds, 4);
+                break;
+            }
+        }
+        pqInputs = std::move(inputs);
+    }
     switch (*calcMode) {
     case CalcMode::ConstQ:
-        pds.resize(tds.size());
-        well->pwd_parallel(tds, pds, 4);
-        qDebug() << "pds OK " << pds;
         ps = ConvertPd_P(pds);
+        dps = ConvertVector(dpds, dimP());
         emit TPQReady(std::make_pair<const std::vector<double>&, const std::vector<double>&>(ts, ps));
         emit TPQDimentionlessReady(std::make_pair<const std::vector<double>&, const std::vector<double>&>(tds, pds));
-        TP = zipStdVectors(ts, ps);
+        if (dps.empty()) {
+            TP = zipStdVectors(ts, ps);
+            TDP.clear();
+        } else {
+            // the derivative goes with the pressure change pInit-p on the log-log plot, not with p
+            TP = zipStdVectors(ts, ConvertVector(pds, dimP()));
+            TDP = zipStdVectors(ts, dps);
+        }
         emit GraphDataReady(TP);
+        emit DerivativeDataReady(TDP);
         break;
     case CalcMode::ConstP:
-        qds.resize(tds.size());
-        well->qwd_parallel(tds, qds, 4);
         qs = ConvertQd_Q(qds);
         emit TPQReady(std::make_pair<const std::vector<double>&, const std::vector<double>&>(ts, qs));
         emit TPQDimentionlessReady(std::make_pair<const std::vector<double>&, const std::vector<double>&>(tds, qds));
         TQ = zipStdVectors(ts, qs);
         emit GraphDataReady(TQ);
+        TDP.clear();
+        emit DerivativeDataReady(TDP);
         break;
     }
+    FinishProfile();
 }
 
 void WellController::CalculateGrid()
 {
     qDebug() << "WellController::CalculateGrid() called";
-    std::unique_ptr<LaplWell> well = makeWell();
+    Profiler::Reset();
     tdsGrid = ConvertT_Td(tsGrid);
     std::vector<double> xdGrid = makeXGrid();
     std::vector<double> ydGrid = makeYGrid();
     std::vector<double> zdGrid = makeZGrid();
-    for (const auto t: tdsGrid) {
-        auto m = well->pd_m_parallel(t, 4, xdGrid, ydGrid, zdGrid);
-        gridPDimentionless.append(std::move(m));
-    };
+    EngineInputs inputs = makeEngineInputs(tdsGrid, {xdGrid, ydGrid, zdGrid,
+            {static_cast<double>(adaptiveGrid), static_cast<double>(lowRankGrid), static_cast<double>(treecodeGrid)}});
+    if (gridInputs && *gridInputs == inputs) {
+        qDebug() << "Dimensionless inputs are unchanged, the cached grid is rescaled";
+    } else {
+        gridInputs.reset();
+#ifdef QPLAPL_PROFILE
+        if (!traceFile.isEmpty()) Trace::Start();
+#endif
+        std::unique_ptr<LaplWell> well = makeWell();
+        gridPDimentionless.clear();
+        for (const auto t: tdsGrid) {
+            TRACE_SCOPE("time step", "td", t);
+            auto m = adaptiveGrid ? well->pd_m_adaptive(t, 4, xdGrid, ydGrid, zdGrid)
+                                  : well->pd_m_parallel(t, 4, xdGrid, ydGrid, zdGrid);
+            gridPDimentionless.append(std::move(m));
+        };
+#ifdef QPLAPL_PROFILE
+        if (Trace::On()) {
+            Trace::Stop();
+            std::ofstream ofs(traceFile.toStdString());
+            if (ofs)
+                qDebug() << "Trace of" << Trace::Write(ofs) << "events written to" << traceFile;
+            else
+                qDebug() << "WellController::CalculateGrid(): can not open" << traceFile;
+        }
+#endif
+        gridInputs = std::move(inputs);
+    }
     gridP = ConvertGrid(gridPDimentionless, lref(), lref(), *h, dimP());
     emit TGridReady(tsGrid);
     emit TGridDimentionlessReady(tdsGrid);
     emit GridReady(gridP);
     emit GridDimentionlessReady(gridPDimentionless);
+    FinishProfile();
+}
+
+void WellController::FinishProfile()
+{
+    profile = Profiler::Collect();
+#ifdef QPLAPL_PROFILE
+    QString report = QString::fromStdString(profile.ToString());
+    qDebug().noquote() << report;
+    emit ProfileReady(report);
+#endif
+}
+
+void WellController::MatchHistory(const std::vector<double>& ts_, const std::vector<double>& ps_, const std::vector<double>& qs_)
+{
+    // the response of the calculation mode is the measured one: pressures at a constant rate, rates at a constant pressure
+    CH_OPT(calcMode);
+    CH_OPT(wellType);
+    CH_OPT(areaShape);
+    CH_OPT(boundaryConditions);
+    CH_OPT(perm);
+    CH_OPT(Fcd);
+    if (*wellType != WellType::Fracture || *areaShape != DrainageArea::Rectangular || *boundaryConditions != Boundary::NNNN)
+        throw std::logic_error("WellController::MatchHistory: only fractured wells in impermeable rectangular areas are supported\n");
+    const std::vector<double>& vals = *calcMode == CalcMode::ConstQ ? ps_ : qs_;
+    if (ts_.size() != vals.size())
+        throw std::logic_error("WellController::MatchHistory: times and measurements differ in size\n");
+    MatchData data;
+    for (size_t i = 0; i < ts_.size(); ++i) {
+        if (ts_[i] > 0.0) {
+            data.ts.push_back(ts_[i]);
+            data.ys.push_back(vals[i]);
+        }
+    }
+    data.tdPerPerm = dimT()/(*perm);
+    switch (*calcMode) {
+    case CalcMode::ConstQ:
+        CH_OPT(pInit);
+        data.kind = MatchKind::Pressure;
+        data.scale = dimP()*(*perm);
+        data.pInit = *pInit;
+        break;
+    case CalcMode::ConstP:
+        data.kind = MatchKind::Rate;
+        data.scale = dimQ()/(*perm);
+        data.pInit = 0.;
+        break;
+    }
+    HistoryMatcher matcher(xwd(), ywd(), data, 4);
+    MatchReport report = matcher.Match({fcd(), xed(), yed(), *perm, skin.value_or(0.)});
+    Fcd = report.params.Fcd;
+    xe = report.params.xed*lref();
+    ye = report.params.yed*lref();
+    perm = report.params.perm;
+    skin = report.params.skin;
+    emit MatchReady(QString::fromStdString(report.ToString()));
+}
+
+void WellController::Deconvolve()
+{
+    CH_OPT(pInit);
+    CH_OPT(qWell);
+    if (psMeasured.size() != ts.size() || qsSchedule.size() != ts.size())
+        throw std::logic_error("WellController::Deconvolve: pressure and rate history are not set\n");
+    if (*qWell == 0.)
+        throw std::logic_error("WellController::Deconvolve: the well rate scales the unit rate response and can not be zero\n");
+    Deconvolution deconv(ts, psMeasured, ts, qsSchedule);
+    DeconvReport report = deconv.Solve(*pInit);
+    std::vector<double> pus, dpus;
+    deconv.Response(ts, pus, dpus);
+    tdsDeconv = ConvertT_Td(ts);
+    pdsDeconv = ConvertVector(pus, (*qWell)/dimP());
+    emit DeconvolutionReady(std::make_pair<const std::vector<double>&, const std::vector<double>&>(tdsDeconv, pdsDeconv));
+    // the model at the constant rate qWell and the response scaled to it, as pressure changes and Bourdet derivatives
+    std::unique_ptr<LaplWell> well = makeWell();
+    std::vector<double> pwds, dpwds;
+    well->pwd_and_derivative(tdsDeconv, pwds, dpwds, 4);
+    TP = zipStdVectors(ts, ConvertVector(pwds, dimP()));
+    TDP = zipStdVectors(ts, ConvertVector(dpwds, dimP()));
+    emit GraphDataReady(TP);
+    emit DerivativeDataReady(TDP);
+    emit DeconvolutionGraphReady(zipStdVectors(ts, ConvertVector(pus, *qWell)), zipStdVectors(ts, ConvertVector(dpus, *qWell)));
+    emit DeconvolutionReportReady(QString::fromStdString(report.ToString()));
 }
 
 void WellController::SavePQT(QTextStream& tstream) const
@@ -223,6 +466,13 @@ void WellController::setPinit(const QString &pinit_str)
     pInit = pinit_str.toDouble();
 }
 
+void WellController::setSkin(const QString &skin_str)
+{
+    if (skin_str.isEmpty())
+        return;
+    skin = skin_str.toDouble();
+}
+
 void WellController::setNfrac(const QString &nfrac_str)
 {
     if (nfrac_str.isEmpty())
@@ -307,6 +557,30 @@ void WellController::setTimeShcheduleGrid(const std::vector<double> &ts_)
     }
 }
 
+void WellController::setRateSchedule(const std::vector<double> &ts_, const std::vector<double> &qs_)
+{
+    qsSchedule.clear();
+    if (ts_.size() != qs_.size())
+        return;
+    qsSchedule.reserve(qs_.size());
+    for (size_t i = 0; i < ts_.size(); ++i) {
+        if (ts_[i] > 0.0)
+            qsSchedule.push_back(qs_[i]);
+    }
+}
+
+void WellController::setPressureHistory(const std::vector<double> &ts_, const std::vector<double> &ps_)
+{
+    psMeasured.clear();
+    if (ts_.size() != ps_.size())
+        return;
+    psMeasured.reserve(ps_.size());
+    for (size_t i = 0; i < ts_.size(); ++i) {
+        if (ts_[i] > 0.0)
+            psMeasured.push_back(ps_[i]);
+    }
+}
+
 void WellController::setNLeft(const QString &n_str, const QString &gridType_str)
 {
     if (n_str.isEmpty() || gridType_str.isEmpty())
@@ -431,6 +705,76 @@ void WellController::setNBetween(const QString &n_str, const QString &gridType_s
     }
 }
 
+void WellController::setAdaptiveGrid(bool adaptive)
+{
+    adaptiveGrid = adaptive;
+}
+
+void WellController::setLowRankGrid(bool lowRank)
+{
+    lowRankGrid = lowRank;
+}
+
+void WellController::setTreecodeGrid(bool treecode)
+{
+    treecodeGrid = treecode;
+}
+
+void WellController::setSurrogate(bool surrogate)
+{
+    this->surrogate = surrogate;
+}
+
+void WellController::setTraceFile(const QString& fname)
+{
+    traceFile = fname;
+}
+
+void WellController::setTypeCurves(const QString& fname)
+{
+    pqInputs.reset();
+    typeCurves.reset();
+    if (fname.isEmpty()) return;
+    typeCurves = std::make_unique<TypeCurveLibrary>(fname.toStdString());
+    qDebug() << "Type curves of" << typeCurves->NNodes() << "fractures from" << fname;
+}
+
+bool WellController::lookupTypeCurves(const std::vector<double>& qdsSchedule)
+{
+    // the table holds NNNN Rectangular::Fracture at the constant rate or pressure, a skin only adds to pwd;
+    // the rate schedule, the surrogate and the curves it does not serve within TC_EPS go to the solver
+    if (!typeCurves || surrogate || !qdsSchedule.empty()) return false;
+    if (!wellType || *wellType != WellType::Fracture || !areaShape || *areaShape != DrainageArea::Rectangular
+            || !boundaryConditions || *boundaryConditions != Boundary::NNNN)
+        return false;
+    FractureParams p{fcd(), xed(), yed(), xwd(), ywd()};
+    TypeCurve curve;
+    size_t n = tds.size();
+    switch (*calcMode) {
+    case CalcMode::ConstQ: {
+        // td*dpwd/dtd by the central difference in log td of the interpolated curve, skin adds to pwd only
+        std::vector<double> tdsAll(tds);
+        for (double td: tds)
+            tdsAll.push_back(td*exp(TC_DLTD));
+        for (double td: tds)
+            tdsAll.push_back(td*exp(-TC_DLTD));
+        if (!typeCurves->LookupPwd(p, tdsAll, curve)) return false;
+        pds.resize(n);
+        dpds.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            pds[i] = curve.vals[i] + skinFactor();
+            dpds[i] = (curve.vals[n+i] - curve.vals[2*n+i])/(2.*TC_DLTD);
+        }
+        break;
+    }
+    case CalcMode::ConstP:
+        if (skinFactor() != 0. || !typeCurves->LookupQwd(p, tds, curve)) return false;
+        qds = curve.vals;
+        break;
+    }
+    qDebug() << "Type curve from the table, error estimate" << curve.err;
+    return true;
+}
 
 double WellController::lref() const
 {
@@ -506,6 +850,17 @@ double WellController::fcd() const
     return *Fcd;
 }
 
+double WellController::permeability() const
+{
+    CH_OPT_MSG(perm, "Permeability is not set\n");
+    return *perm;
+}
+
+double WellController::skinFactor() const
+{
+    return skin.value_or(0.);
+}
+
 WellType WellController::welltype() const
 {
     CH_OPT_MSG(wellType, "Welltype is not set\n");
@@ -576,6 +931,11 @@ const QList<Matrix3DV> &WellController::getGridDimentionless() const
     return gridPDimentionless;
 }
 
+const ProfileReport &WellController::getProfile() const
+{
+    return profile;
+}
+
 void WellController::PrntUnits(QTextStream& tstream) const
 {
     CH_OPT(unitSystem);
@@ -615,6 +975,8 @@ void WellController::PrintWell(QTextStream& tstream) const
         tstream << "Welltype: Fracture\n";
         tstream << "Fracture half-length " << *xf << " " << Units::Maps::Distance.value(us) << "\n";
         tstream << "Fcd " << *Fcd << " " << Units::Maps::DimentionlessConductivity.value(us) << "\n";
+        if (skin)
+            tstream << "Skin " << *skin << "\n";
         break;
     case WellType::Horizontal:
         CH_OPT(lh);
@@ -639,6 +1001,8 @@ void WellController::PrintWell(QTextStream& tstream) const
         CH_OPT(rw);
         tstream << "Welltype: Vertical\n";
         tstream << "Well radius " << *rw << " " << Units::Maps::Distance.value(us) << "\n";
+        if (skin)
+            tstream << "Skin " << *skin << "\n";
         break;
     default:
         tstream << "Unknown welltype\n";
@@ -782,6 +1146,18 @@ double WellController::dimQ() const
     }
 }
 
+bool WellController::isVariableRate() const
+{
+    CH_OPT(qWell);
+    if (qsSchedule.size() != ts.size())
+        return false;
+    for (const auto& q: qsSchedule) {
+        if (q != *qWell)
+            return true;
+    }
+    return false;
+}
+
 std::vector<double> WellController::ConvertPd_P(const std::vector<double> &pds) const
 {
     CH_OPT(pInit);
@@ -898,6 +1274,35 @@ std::vector<double> WellController::makeXGridFracture() const
         gridsetups.push_back(&(*gsWellRight));
         gridsetups.push_back(&(*gsRight));
         return makeGrid(gridpoints, gridsetups);
+    case DrainageArea::Circle:
+        CH_OPT(gsLeft);
+        CH_OPT(gsWellLeft);
+        CH_OPT(gsWellRight);
+        CH_OPT(gsRight);
+        gridpoints.push_back({-red(), -1.});
+        gridpoints.push_back({-1., 0.});
+        gridpoints.push_back({0., 1.});
+        gridpoints.push_back({1., red()});
+        gridsetups.push_back(&(*gsLeft));
+        gridsetups.push_back(&(*gsWellLeft));
+        gridsetups.push_back(&(*gsWellRight));
+        gridsetups.push_back(&(*gsRight));
+        return makeGrid(gridpoints, gridsetups);
+    case DrainageArea::Infinite:
+        // the fracture is centered at the origin as in the circle
+        CH_OPT(gsLeft);
+        CH_OPT(gsWellLeft);
+        CH_OPT(gsWellRight);
+        CH_OPT(gsRight);
+        gridpoints.push_back({-1. - InfiniteExtent(*gsWellLeft, *gsLeft), -1.});
+        gridpoints.push_back({-1., 0.});
+        gridpoints.push_back({0., 1.});
+        gridpoints.push_back({1., 1. + InfiniteExtent(*gsWellRight, *gsRight)});
+        gridsetups.push_back(&(*gsLeft));
+        gridsetups.push_back(&(*gsWellLeft));
+        gridsetups.push_back(&(*gsWellRight));
+        gridsetups.push_back(&(*gsRight));
+        return makeGrid(gridpoints, gridsetups);
     default:
         throw std::logic_error("area shape not implemented\n");
     }
@@ -947,6 +1352,14 @@ std::vector<double> WellController::makeXGridVertical() const
         gridsetups.push_back(&(*gsLeft));
         gridsetups.push_back(&(*gsRight));
         return makeGrid(gridpoints, gridsetups);
+    case DrainageArea::Circle:
+        CH_OPT(gsLeft);
+        CH_OPT(gsRight);
+        gridpoints.push_back({-red(), -1.});
+        gridpoints.push_back({1., red()});
+        gridsetups.push_back(&(*gsLeft));
+        gridsetups.push_back(&(*gsRight));
+        return makeGrid(gridpoints, gridsetups);
     default:
         throw std::logic_error("area shape not implemented\n");
     }
@@ -983,6 +1396,23 @@ std::vector<double> WellController::makeYGridFracture() const
         gridsetups.push_back(&(*gsBottom));
         gridsetups.push_back(&(*gsTop));
         return makeGrid(gridpoints, gridsetups);
+    case DrainageArea::Circle:
+        CH_OPT(gsBottom);
+        CH_OPT(gsTop);
+        gridpoints.push_back({-red(), 0.});
+        gridpoints.push_back({0., red()});
+        gridsetups.push_back(&(*gsBottom));
+        gridsetups.push_back(&(*gsTop));
+        return makeGrid(gridpoints, gridsetups);
+    case DrainageArea::Infinite:
+        CH_OPT(gsWellRight);
+        CH_OPT(gsBottom);
+        CH_OPT(gsTop);
+        gridpoints.push_back({-InfiniteExtent(*gsWellRight, *gsBottom), 0.});
+        gridpoints.push_back({0., InfiniteExtent(*gsWellRight, *gsTop)});
+        gridsetups.push_back(&(*gsBottom));
+        gridsetups.push_back(&(*gsTop));
+        return makeGrid(gridpoints, gridsetups);
     default:
         throw std::logic_error("area shape not implemented\n");
     }
@@ -1007,7 +1437,7 @@ std::vector<double> WellController::makeYGridMultifracture() const
         CH_OPT(gsBetweenRight);
         if (*mFracOrientation == MultifracOrientation::Normal) {
             double lhd = *lh/lref();
-            double dfracd2 = (*lh)/(*nFrac-1);
+            double dfracd2 = lhd/(*nFrac-1);
             double ydstart = ywd() - lhd;
             double ydcur = ydstart;
             double ydend = ywd() + lhd;
@@ -1046,6 +1476,14 @@ std::vector<double> WellController::makeYGridVertical() const
         gridsetups.push_back(&(*gsBottom));
         gridsetups.push_back(&(*gsTop));
         return makeGrid(gridpoints, gridsetups);
+    case DrainageArea::Circle:
+        CH_OPT(gsBottom);
+        CH_OPT(gsTop);
+        gridpoints.push_back({-red(), -1.});
+        gridpoints.push_back({1., red()});
+        gridsetups.push_back(&(*gsBottom));
+        gridsetups.push_back(&(*gsTop));
+        return makeGrid(gridpoints, gridsetups);
     default:
         throw std::logic_error("area shape not implemented\n");
     }
@@ -1097,6 +1535,19 @@ std::vector<double> WellController::makeZGridVertical() const
     return {0.};
 }
 
+double WellController::InfiniteExtent(const WellController::GridSetup &gsWell, const WellController::GridSetup &gsOuter) const
+{
+    // an infinite area has no size of its own, its grid stops where the gsOuter cells, starting from the size
+    // of the gsWell ones and growing by LogGridFactor if logarithmic, run out
+    if (gsWell.nSegments < 1)
+        throw std::logic_error("WellController::InfiniteExtent: the fracture has no grid segments\n");
+    double d1 = 1./gsWell.nSegments;
+    int nseg = gsOuter.nSegments;
+    if (gsOuter.gType == GridType::Lin)
+        return nseg*d1;
+    return d1*(std::pow(LogGridFactor, nseg) - 1.)/(LogGridFactor - 1.);
+}
+
 std::vector<double> WellController::LinLogGrid(double xmin, double xmax, WellController::GridSetup gSetup, double factor) const
 {
     int nseg = gSetup.nSegments;
@@ -8,6 +8,10 @@
 #include <stdexcept>
 #include "interfacemaps.h"
 #include "gwell.h"
+#include "historymatch.h"
+#include "deconvolution.h"
+#include "typecurves.h"
+#include "profiler.h"
 //#include "qgrid1d.h"
 #include <memory>
 #include <QVector>
@@ -40,6 +44,8 @@ public slots:
     void CalculateGrid();
     void SavePQT(QTextStream& tstream) const;
     void SaveGrid(QTextStream& tstream) const;;
+    void MatchHistory(const std::vector<double>& ts_, const std::vector<double>& ps_, const std::vector<double>& qs_);
+    void Deconvolve();
 public:
     explicit WellController(QObject *parent = nullptr);
     // setters
@@ -62,6 +68,7 @@ public:
     void setPwell(const QString& pwell_str);
     void setQwell(const QString& qwell_str);
     void setPinit(const QString& pinit_str);
+    void setSkin(const QString& skin_str);
     void setNfrac(const QString& nfrac_str);
     void setWelltype(const QString& welltype_str);
     void setBoundaryConditions(const QString& bnd_str);
@@ -70,6 +77,8 @@ public:
     void setCalcmode(const QString& cm_str);
     void setTimeSchedule(const std::vector<double>& ts);
     void setTimeShcheduleGrid(const std::vector<double>& ts);
+    void setRateSchedule(const std::vector<double>& ts, const std::vector<double>& qs);
+    void setPressureHistory(const std::vector<double>& ts, const std::vector<double>& ps);
     void setNLeft(const QString& n, const QString& gridType);
     void setNRight(const QString& n, const QString& gridType);
     void setNBottom(const QString& n, const QString& gridType);
@@ -78,6 +87,12 @@ public:
     void setNzBottom(const QString& n, const QString& gridType);
     void setNzTop(const QString& n, const QString& gridType);
     void setNBetween(const QString& n, const QString& gridType);
+    void setAdaptiveGrid(bool adaptive);
+    void setLowRankGrid(bool lowRank); // cross approximation of the far field in the grids of the wells that support it
+    void setTreecodeGrid(bool treecode); // K0 treecode of the grids of the fractures, ahead of the low-rank one
+    void setSurrogate(bool surrogate); // pwd_lapl of CalculatePQ from a SurrogateWell fitted over the schedule
+    void setTraceFile(const QString& fname); // Chrome trace of CalculateGrid with QPLAPL_PROFILE, empty for none
+    void setTypeCurves(const QString& fname); // library of CalculatePQ built by accuracy --typecurves, empty for none
     //getters
     double lref() const;
     double xed() const;
@@ -89,6 +104,8 @@ public:
     double ld() const;
     double hd() const;
     double fcd() const;
+    double permeability() const;
+    double skinFactor() const; // 0 if not set
     WellType welltype() const;
     Boundary boundary() const;
     DrainageArea areashape() const;
@@ -100,7 +117,9 @@ public:
     const std::vector<double>& getTGridDimentionless() const;
     const QList<Matrix3DV>& getGrid() const;
     const QList<Matrix3DV>& getGridDimentionless() const;
+    const ProfileReport& getProfile() const; // kernels of the last CalculatePQ or CalculateGrid, empty without QPLAPL_PROFILE
     static constexpr double LogGridFactor = 1.1;
+    static constexpr const char* TypeCurvesFile = "fracture_typecurves.bin";
     void PrntUnits(QTextStream&) const;
     void PrintFluidRock(QTextStream&) const;
     void PrintWell(QTextStream&) const;
@@ -148,15 +167,22 @@ private:
     };
     std::vector<double> ts, ps, qs;
     std::vector<double> tds, pds, qds;
+    std::vector<double> dps, dpds; // Bourdet derivative t*d(pInit-p)/dt and td*dpwd/dtd
+    std::vector<double> qsSchedule; // rate history aligned with ts, used in ConstQ mode if it differs from qWell
+    std::vector<double> psMeasured; // measured pressures aligned with ts, input of Deconvolve
+    std::vector<double> tdsDeconv, pdsDeconv; // deconvolved unit rate response, comparable with pwd
     std::vector<double> tsGrid;
     std::vector<double> tdsGrid;
+    ProfileReport profile;
     QVector<std::pair<double, double>> TP;
     QVector<std::pair<double, double>> TQ;
+    QVector<std::pair<double, double>> TDP;
     QList<Matrix3DV> gridP;
     QList<Matrix3DV> gridPDimentionless;
     std::optional<double> xe, xw, ye, yw, zw, re, rw, Fcd, xf, lh, h;
     std::optional<double> perm, fi, mu, boil, ct;
     std::optional<double> pWell, qWell, pInit;
+    std::optional<double> skin;
     std::optional<int> nFrac;
     std::optional<MultifracOrientation> mFracOrientation;
     std::optional<WellType> wellType;
@@ -164,10 +190,21 @@ private:
     std::optional<DrainageArea> areaShape;
     std::optional<UnitSystem> unitSystem;
     std::optional<CalcMode> calcMode;
+    struct EngineInputs {
+        // what the engine gets from the controller, a calculation with the inputs of the cached results
+        // only rescales them: pInit, qWell, pWell and the like enter through dimP and dimQ alone
+        std::vector<std::optional<double>> well; // the inputs of makeWell, raw
+        std::vector<double> tds;
+        std::vector<std::vector<double>> extra; // dimensionless rate schedule, grid axes, options
+        bool operator==(const EngineInputs& other) const;
+    };
+    std::optional<EngineInputs> pqInputs, gridInputs; // of pds, qds, dpds and of gridPDimentionless
+    EngineInputs makeEngineInputs(const std::vector<double>& tds, const std::vector<std::vector<double>>& extra) const;
     double dimT() const;
     double dimP() const;
     double dimQ() const;
     std::unique_ptr<LaplWell> makeWell() const;
+    bool isVariableRate() const;
     std::vector<double> ConvertPd_P(const std::vector<double>& pds) const;
     std::vector<double> ConvertQd_Q(const std::vector<double>& qds) const;
     std::vector<double> ConvertTd_T(const std::vector<double>& tds) const;
@@ -194,6 +231,13 @@ private:
     std::optional<GridSetup> gsBottom, gsTop;
     std::optional<GridSetup> gszBottom, gszTop;
     std::optional<GridSetup> gsBetweenLeft, gsBetweenRight;
+    bool adaptiveGrid = false;
+    bool lowRankGrid = false;
+    bool treecodeGrid = false;
+    bool surrogate = false;
+    QString traceFile = "grid_trace.json";
+    std::unique_ptr<TypeCurveLibrary> typeCurves; // NNNN fractures of CalculatePQ, TypeCurvesFile next to the executable
+    bool lookupTypeCurves(const std::vector<double>& qdsSchedule);
     std::vector<double> makeGrid(
             const std::vector<std::pair<double, double>>& gridpoints
           , const std::vector<const GridSetup*>& gridsetups
@@ -215,7 +259,9 @@ private:
     std::vector<double> makeZGridVertical() const;
     // utility
     std::vector<double> LinLogGrid(double xmin, double xmax, GridSetup gSetup, double factor = 1.1) const;
+    double InfiniteExtent(const GridSetup& gsWell, const GridSetup& gsOuter) const; // of the gsOuter cells of an infinite area
     QVector<std::pair<double, double>> zipStdVectors(const std::vector<double>& vfirst, const std::vector<double>& vsecond);
+    void FinishProfile(); // merges the counters of all threads into profile
 signals:
     void TPQReady(std::pair<const std::vector<double>&, const std::vector<double>&>);
     void TPQDimentionlessReady(std::pair<const std::vector<double>&, const std::vector<double>&>);
@@ -224,6 +270,12 @@ signals:
     void GridReady(const QList<Matrix3DV>&);
     void GridDimentionlessReady(const QList<Matrix3DV>&);
     void GraphDataReady(const QVector<std::pair<double, double>>&);
+    void DerivativeDataReady(const QVector<std::pair<double, double>>&);
+    void MatchReady(const QString&);
+    void ProfileReady(const QString&);
+    void DeconvolutionReady(std::pair<const std::vector<double>&, const std::vector<double>&>);
+    void DeconvolutionGraphReady(const QVector<std::pair<double, double>>&, const QVector<std::pair<double, double>>&);
+    void DeconvolutionReportReady(const QString&);
 };
 
 #endif // WELLCONTROLLER_H